@@ -0,0 +1,105 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * No single heuristic and sort order packs every sprite set best, so
+ * 'auto' packs with all of them at once and keeps the smallest atlas.
+ */
+#include "packer.h"
+#include "parallel.h"
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+
+struct auto_candidate {
+  fit_heuristic heuristic;
+  sort_order order;
+  std::vector<image<int>> images;
+  atlas_properties atlas;
+};
+
+static std::uint64_t atlas_area(const atlas_properties &atlas) {
+  std::uint64_t area = 0;
+  for (const atlas_page &page : atlas.pages)
+    area += std::uint64_t(page.width) * page.height;
+  return area;
+}
+
+/* fewer pages first, every page is a texture to bind */
+static bool is_better_atlas(const atlas_properties &a1,
+                            const atlas_properties &a2) {
+  if (a1.pages.size() != a2.pages.size())
+    return a1.pages.size() < a2.pages.size();
+  return atlas_area(a1) < atlas_area(a2);
+}
+
+static std::string page_sizes(const atlas_properties &atlas) {
+  std::string sizes;
+  for (const atlas_page &page : atlas.pages)
+    sizes.append(std::format("{}{}x{}", sizes.empty() ? "" : "+", page.width,
+                             page.height));
+  return sizes;
+}
+
+atlas_properties auto_pack(std::vector<image<int>> &images,
+                           const packer_options &options) {
+  std::vector<auto_candidate> candidates;
+  for (const auto &[heuristic_name, heuristic] : fit_heuristic_names)
+    for (const auto &[order_name, order] : sort_order_names)
+      candidates.push_back({heuristic, order, images, {}});
+
+  /* the candidates already keep every core busy, each of them
+   * searches for its atlas size on a single thread */
+  packer_options single{options};
+  single.jobs = 1;
+  parallel_for(candidates.size(), options.jobs, [&](std::size_t i) {
+    packer_options candidate_options{single};
+    candidate_options.heuristic = candidates[i].heuristic;
+    candidate_options.sort = candidates[i].order;
+    candidates[i].atlas = maxrects(candidates[i].images, candidate_options);
+  });
+
+  std::uint64_t sprite_area = 0;
+  for (const image<int> &img : images)
+    sprite_area += std::uint64_t(img.width) * img.height;
+
+  // matrix order breaks ties so the choice is stable between runs
+  auto_candidate *best = nullptr;
+  std::cout << "Candidates\n";
+  for (std::size_t i = 0; i < candidates.size(); i++) {
+    auto_candidate &candidate = candidates[i];
+    const std::string_view heuristic =
+        fit_heuristic_names[i / sort_order_names.size()].first;
+    const std::string_view order =
+        sort_order_names[i % sort_order_names.size()].first;
+
+    if (candidate.atlas.pages.empty()) {
+      std::cout << std::format("{:>5} {:<10} does not fit\n", heuristic, order);
+      continue;
+    }
+    std::cout << std::format("{:>5} {:<10} {} occupancy {:.2f}%\n", heuristic,
+                             order, page_sizes(candidate.atlas),
+                             100.0 * sprite_area / atlas_area(candidate.atlas));
+
+    if (best == nullptr || is_better_atlas(candidate.atlas, best->atlas))
+      best = &candidate;
+  }
+
+  if (best == nullptr)
+    return candidates.front().atlas;
+
+  images.swap(best->images);
+  return std::move(best->atlas);
+}
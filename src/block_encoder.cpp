@@ -0,0 +1,683 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * BC1, BC3 and BC7 block encoders. Every block stores two endpoint colors
+ * and, per pixel, the index of a color interpolated between them. The
+ * endpoints start at the ends of the principal axis of the block's pixels
+ * and are then refined by least squares against the chosen indices. BC7
+ * only uses modes 6 (one pair of RGBA endpoints) and 5 (separate color and
+ * alpha endpoints), the single subset modes that suit sprites and are by
+ * far the cheapest to search. Picking the closest palette entry for every pixel is the hot
+ * loop and uses SSE2 where available. Formats:
+ * https://learn.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression
+ * https://learn.microsoft.com/en-us/windows/win32/direct3d11/bc7-format-mode-reference
+ */
+#include "block_encoder.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SILLY_PACKER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::uint8_t;
+
+/* the 16 pixels of one block as RGBA, row by row */
+struct block_pixels {
+  alignas(16) uint8_t rgba[64];
+};
+
+std::size_t block_bytes(block_format format) {
+  switch (format) {
+  case block_format::rgba8:
+    return 0;
+  case block_format::bc1:
+    return 8;
+  case block_format::bc3:
+  case block_format::bc7:
+    return 16;
+  }
+  return 0;
+}
+
+static void load_block(const uint8_t *pixels, uint32_t width, uint32_t height,
+                       int components_per_pixel, uint32_t block_x,
+                       uint32_t block_y, block_pixels &block) {
+  for (uint32_t y = 0; y < block_side; y++) {
+    const uint32_t source_y = std::min(block_y * block_side + y, height - 1);
+    for (uint32_t x = 0; x < block_side; x++) {
+      const uint32_t source_x = std::min(block_x * block_side + x, width - 1);
+      const uint8_t *source =
+          pixels + (std::size_t(source_y) * width + source_x) *
+                       components_per_pixel;
+      uint8_t *pixel = block.rgba + (y * block_side + x) * 4;
+      switch (components_per_pixel) {
+      case 1:
+        pixel[0] = pixel[1] = pixel[2] = source[0];
+        pixel[3] = 255;
+        break;
+      case 2:
+        pixel[0] = pixel[1] = pixel[2] = source[0];
+        pixel[3] = source[1];
+        break;
+      case 3:
+        std::memcpy(pixel, source, 3);
+        pixel[3] = 255;
+        break;
+      default:
+        std::memcpy(pixel, source, 4);
+      }
+    }
+  }
+}
+
+/* for every pixel the index of the closest of the first count palette
+ * entries (squared RGBA distance, the first entry wins a tie) and that
+ * distance. zero the alpha of both sides to compare colors only */
+static void nearest_entries(const block_pixels &block,
+                            const uint8_t (*palette)[4], int count,
+                            uint8_t indices[16], uint32_t errors[16]) {
+#ifdef SILLY_PACKER_SSE2
+  // two pixels per register, widened to 16 bit channels
+  const __m128i zero = _mm_setzero_si128();
+  __m128i wide[8];
+  for (int i = 0; i < 4; i++) {
+    const __m128i pixels =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(block.rgba + 16 * i));
+    wide[2 * i] = _mm_unpacklo_epi8(pixels, zero);
+    wide[2 * i + 1] = _mm_unpackhi_epi8(pixels, zero);
+  }
+
+  __m128i best[4], best_index[4];
+  for (int e = 0; e < count; e++) {
+    uint32_t entry;
+    std::memcpy(&entry, palette[e], sizeof(entry));
+    const __m128i color = _mm_unpacklo_epi8(_mm_set1_epi32(entry), zero);
+    const __m128i index = _mm_set1_epi32(e);
+    for (int quad = 0; quad < 4; quad++) {
+      __m128i low = _mm_sub_epi16(wide[2 * quad], color);
+      __m128i high = _mm_sub_epi16(wide[2 * quad + 1], color);
+      // r*r+g*g and b*b+a*a of each pixel, then summed per pixel
+      low = _mm_madd_epi16(low, low);
+      high = _mm_madd_epi16(high, high);
+      const __m128 low_ps = _mm_castsi128_ps(low);
+      const __m128 high_ps = _mm_castsi128_ps(high);
+      const __m128i distance = _mm_add_epi32(
+          _mm_castps_si128(
+              _mm_shuffle_ps(low_ps, high_ps, _MM_SHUFFLE(2, 0, 2, 0))),
+          _mm_castps_si128(
+              _mm_shuffle_ps(low_ps, high_ps, _MM_SHUFFLE(3, 1, 3, 1))));
+      if (e == 0) {
+        best[quad] = distance;
+        best_index[quad] = index;
+        continue;
+      }
+      const __m128i closer = _mm_cmplt_epi32(distance, best[quad]);
+      best[quad] = _mm_or_si128(_mm_and_si128(closer, distance),
+                                _mm_andnot_si128(closer, best[quad]));
+      best_index[quad] = _mm_or_si128(_mm_and_si128(closer, index),
+                                      _mm_andnot_si128(closer, best_index[quad]));
+    }
+  }
+
+  alignas(16) uint32_t picked[16];
+  for (int quad = 0; quad < 4; quad++) {
+    _mm_store_si128(reinterpret_cast<__m128i *>(errors + 4 * quad), best[quad]);
+    _mm_store_si128(reinterpret_cast<__m128i *>(picked + 4 * quad),
+                    best_index[quad]);
+  }
+  for (int i = 0; i < 16; i++)
+    indices[i] = picked[i];
+#else
+  for (int i = 0; i < 16; i++) {
+    const uint8_t *pixel = block.rgba + 4 * i;
+    for (int e = 0; e < count; e++) {
+      uint32_t distance = 0;
+      for (int c = 0; c < 4; c++) {
+        const int d = int(pixel[c]) - palette[e][c];
+        distance += d * d;
+      }
+      if (e == 0 || distance < errors[i]) {
+        errors[i] = distance;
+        indices[i] = e;
+      }
+    }
+  }
+#endif
+}
+
+/* mean and principal axis of the used pixels in the first channels
+ * channels, the axis comes from power iteration on their covariance and
+ * is zero for a block of a single color */
+static void principal_axis(const block_pixels &block, const bool used[16],
+                           int channels, float mean[4], float axis[4]) {
+  int count = 0;
+  std::fill_n(mean, 4, 0.0f);
+  for (int i = 0; i < 16; i++) {
+    if (not used[i])
+      continue;
+    count++;
+    for (int c = 0; c < channels; c++)
+      mean[c] += block.rgba[4 * i + c];
+  }
+  for (int c = 0; c < channels; c++)
+    mean[c] /= std::max(count, 1);
+
+  float covariance[4][4] = {};
+  for (int i = 0; i < 16; i++) {
+    if (not used[i])
+      continue;
+    float d[4];
+    for (int c = 0; c < channels; c++)
+      d[c] = block.rgba[4 * i + c] - mean[c];
+    for (int r = 0; r < channels; r++)
+      for (int c = 0; c < channels; c++)
+        covariance[r][c] += d[r] * d[c];
+  }
+
+  // the row of the channel that varies most is a good first guess
+  int widest = 0;
+  for (int c = 1; c < channels; c++)
+    if (covariance[c][c] > covariance[widest][widest])
+      widest = c;
+  float v[4] = {};
+  for (int c = 0; c < channels; c++)
+    v[c] = covariance[widest][c];
+
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float next[4] = {};
+    float largest = 0.0f;
+    for (int r = 0; r < channels; r++) {
+      for (int c = 0; c < channels; c++)
+        next[r] += covariance[r][c] * v[c];
+      largest = std::max(largest, std::fabs(next[r]));
+    }
+    if (largest == 0.0f)
+      break;
+    for (int c = 0; c < channels; c++)
+      v[c] = next[c] / largest;
+  }
+
+  float length = 0.0f;
+  for (int c = 0; c < channels; c++)
+    length += v[c] * v[c];
+  length = std::sqrt(length);
+  std::fill_n(axis, 4, 0.0f);
+  if (length == 0.0f)
+    return;
+  for (int c = 0; c < channels; c++)
+    axis[c] = v[c] / length;
+}
+
+/* the two points of the principal axis between which the used pixels lie */
+static void axis_endpoints(const block_pixels &block, const bool used[16],
+                           int channels, float e0[4], float e1[4]) {
+  float mean[4], axis[4];
+  principal_axis(block, used, channels, mean, axis);
+
+  float low = 0.0f, high = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    if (not used[i])
+      continue;
+    float t = 0.0f;
+    for (int c = 0; c < channels; c++)
+      t += (block.rgba[4 * i + c] - mean[c]) * axis[c];
+    low = std::min(low, t);
+    high = std::max(high, t);
+  }
+  for (int c = 0; c < 4; c++) {
+    e0[c] = std::clamp(mean[c] + low * axis[c], 0.0f, 255.0f);
+    e1[c] = std::clamp(mean[c] + high * axis[c], 0.0f, 255.0f);
+  }
+}
+
+/* least squares endpoints for the used pixels, weights[i] is how far
+ * along from e0 to e1 pixel i was placed. false if the weights do not
+ * pin the endpoints down, e.g. every pixel uses the same one */
+static bool refine_endpoints(const block_pixels &block, const bool used[16],
+                             const float weights[16], int channels, float e0[4],
+                             float e1[4]) {
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  float ax[4] = {}, bx[4] = {};
+  for (int i = 0; i < 16; i++) {
+    if (not used[i])
+      continue;
+    const float b = weights[i], a = 1.0f - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (int c = 0; c < channels; c++) {
+      ax[c] += a * block.rgba[4 * i + c];
+      bx[c] += b * block.rgba[4 * i + c];
+    }
+  }
+
+  const float determinant = aa * bb - ab * ab;
+  if (std::fabs(determinant) < 1e-6f)
+    return false;
+  for (int c = 0; c < channels; c++) {
+    e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+    e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+static uint16_t pack_565(const float color[4]) {
+  const uint16_t r = std::lround(color[0] * 31.0f / 255.0f);
+  const uint16_t g = std::lround(color[1] * 63.0f / 255.0f);
+  const uint16_t b = std::lround(color[2] * 31.0f / 255.0f);
+  return (r << 11) | (g << 5) | b;
+}
+
+static void unpack_565(uint16_t packed, uint8_t color[4]) {
+  const int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+  color[3] = 0;
+}
+
+struct color_fit {
+  uint16_t c0 = 0, c1 = 0;
+  bool three_color = false;
+  uint8_t indices[16] = {};
+  uint64_t error = UINT64_MAX;
+};
+
+/* indices and error of the used pixels for one pair of 565 endpoints.
+ * the order of the endpoints picks the mode: c0 > c1 interpolates two
+ * colors in between, c0 <= c1 only one and leaves index 3 transparent */
+static color_fit fit_colors(const block_pixels &rgb, const bool used[16],
+                              bool three_color, uint16_t c0, uint16_t c1) {
+  color_fit fit{.three_color = three_color};
+  if (three_color ? c0 > c1 : c0 < c1)
+    std::swap(c0, c1);
+  fit.c0 = c0;
+  fit.c1 = c1;
+
+  uint8_t palette[4][4];
+  unpack_565(c0, palette[0]);
+  unpack_565(c1, palette[1]);
+  int count = 4;
+  if (three_color) {
+    for (int c = 0; c < 3; c++)
+      palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+    count = 3;
+  } else if (c0 == c1) {
+    // equal endpoints decode in the three color mode, index 0 is safe
+    count = 1;
+  } else {
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+    }
+  }
+  for (int e = 2; e < 4; e++)
+    palette[e][3] = 0;
+
+  uint32_t errors[16];
+  nearest_entries(rgb, palette, count, fit.indices, errors);
+  fit.error = 0;
+  for (int i = 0; i < 16; i++)
+    if (used[i])
+      fit.error += errors[i];
+  return fit;
+}
+
+/* the 8 byte color half of BC1 and BC3. with punch_through, pixels with
+ * an alpha below 128 are stored transparent (BC1 only), otherwise only
+ * fully transparent pixels are left out of the fit since nothing shows
+ * their color */
+static void encode_color_block(const block_pixels &block, bool punch_through,
+                                uint8_t out[8]) {
+  block_pixels rgb = block;
+  bool used[16];
+  bool any_used = false, transparent = false;
+  for (int i = 0; i < 16; i++) {
+    const uint8_t alpha = block.rgba[4 * i + 3];
+    used[i] = punch_through ? alpha >= 128 : alpha > 0;
+    any_used |= used[i];
+    transparent |= not used[i];
+    rgb.rgba[4 * i + 3] = 0;
+  }
+  const bool three_color = punch_through && transparent;
+
+  if (not any_used) {
+    // 0 <= 0 selects the three color mode, index 3 is transparent
+    std::memset(out, 0, 4);
+    std::memset(out + 4, punch_through ? 0xff : 0, 4);
+    return;
+  }
+
+  float e0[4], e1[4];
+  axis_endpoints(rgb, used, 3, e0, e1);
+  color_fit best =
+      fit_colors(rgb, used, three_color, pack_565(e0), pack_565(e1));
+
+  static constexpr float four_color_weights[4] = {0.0f, 1.0f, 1.0f / 3.0f,
+                                                   2.0f / 3.0f};
+  static constexpr float three_color_weights[4] = {0.0f, 1.0f, 0.5f, 0.0f};
+  for (int iteration = 0; iteration < 2; iteration++) {
+    const float *step_weights =
+        three_color ? three_color_weights : four_color_weights;
+    float weights[16];
+    for (int i = 0; i < 16; i++)
+      weights[i] = step_weights[best.indices[i]];
+    if (not refine_endpoints(rgb, used, weights, 3, e0, e1))
+      break;
+    color_fit refined =
+        fit_colors(rgb, used, three_color, pack_565(e0), pack_565(e1));
+    if (refined.error >= best.error)
+      break;
+    best = refined;
+  }
+
+  uint32_t bits = 0;
+  for (int i = 0; i < 16; i++)
+    bits |= uint32_t(used[i] || not three_color ? best.indices[i] : 3)
+            << (2 * i);
+  const uint8_t bytes[8] = {
+      uint8_t(best.c0),      uint8_t(best.c0 >> 8), uint8_t(best.c1),
+      uint8_t(best.c1 >> 8), uint8_t(bits),         uint8_t(bits >> 8),
+      uint8_t(bits >> 16),   uint8_t(bits >> 24)};
+  std::memcpy(out, bytes, 8);
+}
+
+/* closest alpha of the 8 entry palette for every pixel, returns the error */
+static uint64_t fit_alpha(const block_pixels &block, const int palette[8],
+                          uint8_t indices[16]) {
+  uint64_t error = 0;
+  for (int i = 0; i < 16; i++) {
+    const int alpha = block.rgba[4 * i + 3];
+    int best = 0;
+    for (int e = 1; e < 8; e++)
+      if (std::abs(alpha - palette[e]) < std::abs(alpha - palette[best]))
+        best = e;
+    indices[i] = best;
+    const int d = alpha - palette[best];
+    error += d * d;
+  }
+  return error;
+}
+
+/* the 8 byte alpha half of BC3. a0 > a1 interpolates six steps between
+ * them, a0 <= a1 only four but adds exact 0 and 255, which suits sprites
+ * with hard transparent edges around a soft part */
+static void encode_alpha_block(const block_pixels &block, uint8_t out[8]) {
+  int low = 255, high = 0, inner_low = 255, inner_high = 0;
+  for (int i = 0; i < 16; i++) {
+    const int alpha = block.rgba[4 * i + 3];
+    low = std::min(low, alpha);
+    high = std::max(high, alpha);
+    if (alpha != 0 && alpha != 255) {
+      inner_low = std::min(inner_low, alpha);
+      inner_high = std::max(inner_high, alpha);
+    }
+  }
+
+  int a0 = high, a1 = low;
+  uint8_t indices[16] = {};
+  if (low != high) {
+    int eight[8] = {high, low};
+    for (int e = 2; e < 8; e++)
+      eight[e] = ((8 - e) * high + (e - 1) * low + 3) / 7;
+    const uint64_t eight_error = fit_alpha(block, eight, indices);
+
+    if (inner_low > inner_high)
+      inner_low = inner_high = 0;
+    int six[8] = {inner_low, inner_high};
+    for (int e = 2; e < 6; e++)
+      six[e] = ((6 - e) * inner_low + (e - 1) * inner_high + 2) / 5;
+    six[6] = 0;
+    six[7] = 255;
+    uint8_t six_indices[16];
+    if (fit_alpha(block, six, six_indices) < eight_error) {
+      a0 = inner_low;
+      a1 = inner_high;
+      std::memcpy(indices, six_indices, 16);
+    }
+  }
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 16; i++)
+    bits |= uint64_t(indices[i]) << (3 * i);
+  out[0] = a0;
+  out[1] = a1;
+  for (int b = 0; b < 6; b++)
+    out[2 + b] = uint8_t(bits >> (8 * b));
+}
+
+/* one pair of BC7 endpoints (7 or 8 bit, mode 6 adds a shared low bit
+ * to each) and the index of every pixel between them */
+struct bc7_line {
+  uint8_t e0[4] = {}, e1[4] = {};
+  int p0 = 0, p1 = 0;
+  uint8_t indices[16] = {};
+  uint64_t error = UINT64_MAX;
+};
+
+static constexpr int bc7_weights_2[4] = {0, 21, 43, 64};
+static constexpr int bc7_weights_4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                          34, 38, 43, 47, 51, 55, 60, 64};
+
+static uint8_t bc7_interpolate(int v0, int v1, int weight) {
+  return ((64 - weight) * v0 + weight * v1 + 32) >> 6;
+}
+
+static uint64_t total_error(const uint32_t errors[16]) {
+  uint64_t total = 0;
+  for (int i = 0; i < 16; i++)
+    total += errors[i];
+  return total;
+}
+
+/* mode 6 endpoints, every combination of the two low bits is tried */
+static bc7_line fit_mode_6(const block_pixels &block, const float e0[4],
+                           const float e1[4]) {
+  bc7_line best;
+  for (int p = 0; p < 4; p++) {
+    bc7_line fit{.p0 = p & 1, .p1 = p >> 1};
+    uint8_t palette[16][4];
+    for (int c = 0; c < 4; c++) {
+      fit.e0[c] = std::clamp(std::lround((e0[c] - fit.p0) / 2.0f), 0l, 127l);
+      fit.e1[c] = std::clamp(std::lround((e1[c] - fit.p1) / 2.0f), 0l, 127l);
+      for (int e = 0; e < 16; e++)
+        palette[e][c] =
+            bc7_interpolate((fit.e0[c] << 1) | fit.p0,
+                            (fit.e1[c] << 1) | fit.p1, bc7_weights_4[e]);
+    }
+
+    uint32_t errors[16];
+    nearest_entries(block, palette, 16, fit.indices, errors);
+    fit.error = total_error(errors);
+    if (fit.error < best.error)
+      best = fit;
+  }
+  return best;
+}
+
+/* endpoints of the first channels channels at bits bits each, with 4
+ * steps between them. the other channels of block must be zero */
+static bc7_line fit_mode_5(const block_pixels &block, int channels, int bits,
+                           const float e0[4], const float e1[4]) {
+  bc7_line fit;
+  const long top = (1 << bits) - 1;
+  uint8_t palette[4][4] = {};
+  for (int c = 0; c < channels; c++) {
+    fit.e0[c] = std::clamp(std::lround(e0[c] * top / 255.0f), 0l, top);
+    fit.e1[c] = std::clamp(std::lround(e1[c] * top / 255.0f), 0l, top);
+    // 7 bit endpoints are widened by repeating their top bit
+    const int v0 = bits == 8 ? fit.e0[c] : (fit.e0[c] << 1) | (fit.e0[c] >> 6);
+    const int v1 = bits == 8 ? fit.e1[c] : (fit.e1[c] << 1) | (fit.e1[c] >> 6);
+    for (int e = 0; e < 4; e++)
+      palette[e][c] = bc7_interpolate(v0, v1, bc7_weights_2[e]);
+  }
+
+  uint32_t errors[16];
+  nearest_entries(block, palette, 4, fit.indices, errors);
+  fit.error = total_error(errors);
+  return fit;
+}
+
+/* starts at the ends of the principal axis and refines by least squares
+ * while that lowers the error. fit(e0, e1) quantizes the endpoints and
+ * picks the indices, weights maps an index to its interpolation weight */
+template <typename Fit>
+static bc7_line search_line(const block_pixels &block, int channels,
+                            const int *weights, Fit &&fit) {
+  bool used[16];
+  std::fill_n(used, 16, true);
+  float e0[4], e1[4];
+  axis_endpoints(block, used, channels, e0, e1);
+  bc7_line best = fit(e0, e1);
+
+  for (int iteration = 0; iteration < 2; iteration++) {
+    float along[16];
+    for (int i = 0; i < 16; i++)
+      along[i] = weights[best.indices[i]] / 64.0f;
+    if (not refine_endpoints(block, used, along, channels, e0, e1))
+      break;
+    bc7_line refined = fit(e0, e1);
+    if (refined.error >= best.error)
+      break;
+    best = refined;
+  }
+  return best;
+}
+
+/* the first index of a set is stored with its top bit implied zero,
+ * swapping the endpoints flips every index */
+static void fix_anchor(bc7_line &line, int index_bits) {
+  const int top = (1 << index_bits) - 1;
+  if (line.indices[0] <= top / 2)
+    return;
+  std::swap(line.e0, line.e1);
+  std::swap(line.p0, line.p1);
+  for (uint8_t &index : line.indices)
+    index = top - index;
+}
+
+/* appends bits to a zeroed block, least significant bit first */
+struct bit_writer {
+  uint8_t *out;
+  int position = 0;
+
+  void put(uint32_t value, int bits) {
+    for (int i = 0; i < bits; i++, position++)
+      if ((value >> i) & 1)
+        out[position >> 3] |= 1 << (position & 7);
+  }
+};
+
+/* mode 6 fits RGBA along one line, mode 5 gives alpha its own endpoints
+ * and indices, which holds up better where soft alpha edges meet
+ * differently colored pixels. the one with the lower error is stored */
+static void encode_bc7_block(const block_pixels &block, uint8_t out[16]) {
+  bc7_line mode_6 = search_line(
+      block, 4, bc7_weights_4,
+      [&](const float *e0, const float *e1) { return fit_mode_6(block, e0, e1); });
+
+  block_pixels rgb = block, alpha = {};
+  for (int i = 0; i < 16; i++) {
+    rgb.rgba[4 * i + 3] = 0;
+    alpha.rgba[4 * i] = block.rgba[4 * i + 3];
+  }
+  bc7_line mode_5_rgb = search_line(
+      rgb, 3, bc7_weights_2, [&](const float *e0, const float *e1) {
+        return fit_mode_5(rgb, 3, 7, e0, e1);
+      });
+  bc7_line mode_5_alpha = search_line(
+      alpha, 1, bc7_weights_2, [&](const float *e0, const float *e1) {
+        return fit_mode_5(alpha, 1, 8, e0, e1);
+      });
+
+  std::memset(out, 0, 16);
+  bit_writer writer{out};
+  if (mode_6.error <= mode_5_rgb.error + mode_5_alpha.error) {
+    fix_anchor(mode_6, 4);
+    writer.put(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+      writer.put(mode_6.e0[c], 7);
+      writer.put(mode_6.e1[c], 7);
+    }
+    writer.put(mode_6.p0, 1);
+    writer.put(mode_6.p1, 1);
+    writer.put(mode_6.indices[0], 3);
+    for (int i = 1; i < 16; i++)
+      writer.put(mode_6.indices[i], 4);
+    return;
+  }
+
+  fix_anchor(mode_5_rgb, 2);
+  fix_anchor(mode_5_alpha, 2);
+  // mode bits, then rotation 0 keeps the channels where they are
+  writer.put(1 << 5, 6);
+  writer.put(0, 2);
+  for (int c = 0; c < 3; c++) {
+    writer.put(mode_5_rgb.e0[c], 7);
+    writer.put(mode_5_rgb.e1[c], 7);
+  }
+  writer.put(mode_5_alpha.e0[0], 8);
+  writer.put(mode_5_alpha.e1[0], 8);
+  for (const bc7_line *line : {&mode_5_rgb, &mode_5_alpha}) {
+    writer.put(line->indices[0], 1);
+    for (int i = 1; i < 16; i++)
+      writer.put(line->indices[i], 2);
+  }
+}
+
+std::vector<std::uint8_t> encode_blocks(const std::uint8_t *pixels,
+                                        std::uint32_t width,
+                                        std::uint32_t height,
+                                        int components_per_pixel,
+                                        block_format format,
+                                        unsigned int jobs) {
+  const std::size_t bytes = block_bytes(format);
+  const uint32_t columns = (width + block_side - 1) / block_side;
+  const uint32_t rows = (height + block_side - 1) / block_side;
+  std::vector<std::uint8_t> encoded(std::size_t(columns) * rows * bytes);
+
+  parallel_for(rows, jobs, [&](std::size_t row) {
+    block_pixels block;
+    for (uint32_t column = 0; column < columns; column++) {
+      load_block(pixels, width, height, components_per_pixel, column, row,
+                 block);
+      uint8_t *out =
+          encoded.data() + (std::size_t(row) * columns + column) * bytes;
+      switch (format) {
+      case block_format::bc1:
+        encode_color_block(block, true, out);
+        break;
+      case block_format::bc3:
+        encode_alpha_block(block, out);
+        encode_color_block(block, false, out + 8);
+        break;
+      case block_format::bc7:
+        encode_bc7_block(block, out);
+        break;
+      case block_format::rgba8:
+        break;
+      }
+    }
+  });
+  return encoded;
+}
@@ -0,0 +1,62 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_BLOCK_ENCODER_H
+#define SILLY_PACKER_BLOCK_ENCODER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* texture layout of the atlas pages. rgba8 keeps the raw pixels, the
+ * others are GPU block compression formats that store every 4x4 pixels
+ * in a fixed size block: bc1 (DXT1, 1 bit alpha) in 8 bytes, bc3 (DXT5)
+ * and bc7 (BPTC) in 16 */
+enum class block_format {
+  rgba8,
+  bc1,
+  bc3,
+  bc7,
+};
+
+inline constexpr std::array<std::pair<std::string_view, block_format>, 4>
+    block_format_names{{
+        {"rgba8", block_format::rgba8},
+        {"bc1", block_format::bc1},
+        {"bc3", block_format::bc3},
+        {"bc7", block_format::bc7},
+    }};
+
+/* side of the pixel blocks, sprites are placed at multiples of it so
+ * that no block mixes two of them */
+inline constexpr int block_side = 4;
+
+/* bytes of one 4x4 block, 0 for rgba8 */
+std::size_t block_bytes(block_format format);
+
+/* compresses a width x height image into rows of blocks, left to right and
+ * top to bottom. pixels past the right and bottom edge repeat the last
+ * column and row. block rows are spread over up to jobs threads */
+std::vector<std::uint8_t> encode_blocks(const std::uint8_t *pixels,
+                                        std::uint32_t width,
+                                        std::uint32_t height,
+                                        int components_per_pixel,
+                                        block_format format,
+                                        unsigned int jobs);
+
+#endif
@@ -0,0 +1,156 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Incremental build cache. A run with --cache records the options, a
+ * fingerprint of every input and output file and the layout it packed in
+ * <header>.cache. The next run compares against it: with nothing changed
+ * it stops before decoding anything, and with only pixels changed it
+ * skips the packing and reuses the layout. With --stable the layout is
+ * also the starting point when images were added, removed or resized.
+ * Content is compared through a 64 bit hash, a change that keeps the
+ * hash would go unnoticed.
+ */
+#include "build_cache.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+/* bumped whenever the format or what it describes changes */
+static constexpr const char *cache_signature = "silly_packer cache 2";
+
+std::filesystem::path build_cache_path(const std::filesystem::path &header) {
+  std::filesystem::path path = header;
+  path += ".cache";
+  return path;
+}
+
+file_fingerprint fingerprint_file(const std::string &path,
+                                  const file_fingerprint *known,
+                                  bool hash_content) {
+  file_fingerprint fingerprint{.path = path};
+  std::error_code error;
+  const std::uintmax_t size = std::filesystem::file_size(path, error);
+  if (error)
+    return fingerprint;
+  const auto modified = std::filesystem::last_write_time(path, error);
+  if (error)
+    return fingerprint;
+
+  fingerprint.exists = true;
+  fingerprint.size = size;
+  fingerprint.modified = modified.time_since_epoch().count();
+  if (not hash_content)
+    return fingerprint;
+
+  if (known != nullptr && known->exists && known->size == fingerprint.size &&
+      known->modified == fingerprint.modified) {
+    fingerprint.hash = known->hash;
+    return fingerprint;
+  }
+  mapped_file content(path);
+  if (content.is_open())
+    fingerprint.hash = content_hash(content.data(), content.size());
+  return fingerprint;
+}
+
+/* the path is always last on its line, after exactly one space */
+static std::string read_path(std::istringstream &line) {
+  std::string path;
+  line.get();
+  std::getline(line, path);
+  return path;
+}
+
+bool read_build_cache(const std::filesystem::path &path, build_cache &cache) {
+  std::ifstream input(path);
+  std::string text;
+  if (not std::getline(input, text) || text != cache_signature)
+    return false;
+
+  while (std::getline(input, text)) {
+    std::istringstream line(text);
+    std::string kind;
+    line >> kind;
+    if (kind == "options") {
+      line >> cache.options_hash;
+    } else if (kind == "layout") {
+      line >> cache.layout_hash;
+    } else if (kind == "input" || kind == "output") {
+      file_fingerprint file;
+      line >> file.exists >> file.size >> file.modified >> file.hash;
+      file.path = read_path(line);
+      (kind == "input" ? cache.inputs : cache.outputs).push_back(file);
+    } else if (kind == "page") {
+      atlas_page page;
+      line >> page.width >> page.height;
+      cache.pages.push_back(page);
+    } else if (kind == "sprite") {
+      cached_sprite sprite;
+      rectangle &rect = sprite.rect;
+      line >> rect.x >> rect.y >> rect.width >> rect.height >> rect.rotated >>
+          rect.page >> sprite.width >> sprite.height >> sprite.offset_x >>
+          sprite.offset_y >> sprite.source_width >> sprite.source_height;
+      sprite.path = read_path(line);
+      cache.sprites.push_back(sprite);
+    } else {
+      return false;
+    }
+    if (line.fail())
+      return false;
+  }
+  return true;
+}
+
+void write_build_cache(const std::filesystem::path &path,
+                       const build_cache &cache) {
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  bool written = false;
+  {
+    std::ofstream output(temporary);
+    if (not output.is_open())
+      return;
+    output << cache_signature << '\n';
+    output << "options " << cache.options_hash << '\n';
+    output << "layout " << cache.layout_hash << '\n';
+    for (const file_fingerprint &file : cache.inputs)
+      output << "input " << file.exists << ' ' << file.size << ' '
+             << file.modified << ' ' << file.hash << ' ' << file.path << '\n';
+    for (const file_fingerprint &file : cache.outputs)
+      output << "output " << file.exists << ' ' << file.size << ' '
+             << file.modified << ' ' << file.hash << ' ' << file.path << '\n';
+    for (const atlas_page &page : cache.pages)
+      output << "page " << page.width << ' ' << page.height << '\n';
+    for (const cached_sprite &sprite : cache.sprites) {
+      const rectangle &rect = sprite.rect;
+      output << "sprite " << rect.x << ' ' << rect.y << ' ' << rect.width
+             << ' ' << rect.height << ' ' << rect.rotated << ' ' << rect.page
+             << ' ' << sprite.width << ' ' << sprite.height << ' '
+             << sprite.offset_x << ' ' << sprite.offset_y << ' '
+             << sprite.source_width << ' ' << sprite.source_height << ' '
+             << sprite.path << '\n';
+    }
+    output.close();
+    written = not output.fail();
+  }
+
+  std::error_code error;
+  if (written)
+    std::filesystem::rename(temporary, path, error);
+  if (not written || error)
+    std::filesystem::remove(temporary, error);
+}
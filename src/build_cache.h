@@ -0,0 +1,76 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_BUILD_CACHE_H
+#define SILLY_PACKER_BUILD_CACHE_H
+
+#include "packer.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/* a file as it was seen by a run. a file whose size and modification
+ * time have not moved is taken to still have the recorded content */
+struct file_fingerprint {
+  std::string path;
+  bool exists = false;
+  std::uint64_t size = 0;
+  std::int64_t modified = 0;
+  std::uint64_t hash = 0;
+
+  bool operator==(const file_fingerprint &) const = default;
+};
+
+/* where a packed image ended up, together with the size it was packed
+ * at, so that an image whose pixels changed can still be recognized */
+struct cached_sprite {
+  std::string path;
+  rectangle rect;
+  int width, height, offset_x, offset_y, source_width, source_height;
+};
+
+/* what a run with --cache leaves next to the header for the next one */
+struct build_cache {
+  std::uint64_t options_hash = 0;
+  /* only the options that decide where images go */
+  std::uint64_t layout_hash = 0;
+  /* image inputs, then extra files, in argument order */
+  std::vector<file_fingerprint> inputs;
+  std::vector<file_fingerprint> outputs;
+  std::vector<atlas_page> pages;
+  /* in the order the packer sorted the images into */
+  std::vector<cached_sprite> sprites;
+};
+
+/* <header>.cache */
+std::filesystem::path build_cache_path(const std::filesystem::path &header);
+
+/* false if there is no cache or it is not one this version understands */
+bool read_build_cache(const std::filesystem::path &path, build_cache &cache);
+
+/* replaces the cache in one step, a failed write only costs the next run
+ * its shortcut */
+void write_build_cache(const std::filesystem::path &path,
+                       const build_cache &cache);
+
+/* the hash of known is reused when size and time match it, otherwise
+ * the content is read and hashed unless hash_content is false */
+file_fingerprint fingerprint_file(const std::string &path,
+                                  const file_fingerprint *known,
+                                  bool hash_content);
+
+#endif
@@ -0,0 +1,139 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Byte to text encoders for the generated header. Every byte maps to a
+ * short precomputed piece of text, which is copied into a fixed buffer
+ * that is handed to the stream whenever it fills up. Nothing grows with
+ * the size of the data, unlike formatting it into one big string.
+ */
+#include "byte_encoder.h"
+#include <array>
+#include <cstring>
+
+/* text for one byte, at most 4 characters */
+struct byte_text {
+  char text[4];
+  std::uint8_t length;
+};
+
+using byte_table = std::array<byte_text, 256>;
+
+static constexpr std::size_t chunk_size = 1 << 16;
+/* characters per string literal piece, keeps lines short enough for
+ * editors and below the piece limits some compilers have */
+static constexpr std::size_t literal_piece = 4096;
+
+/* "0," to "255," */
+static constexpr byte_table make_decimal_table() {
+  byte_table table{};
+  for (int value = 0; value < 256; value++) {
+    byte_text &entry = table[value];
+    if (value >= 100)
+      entry.text[entry.length++] = char('0' + value / 100);
+    if (value >= 10)
+      entry.text[entry.length++] = char('0' + value / 10 % 10);
+    entry.text[entry.length++] = char('0' + value % 10);
+    entry.text[entry.length++] = ',';
+  }
+  return table;
+}
+
+static constexpr bool is_plain(int value) {
+  return value >= ' ' && value <= '~' && value != '"' && value != '\\' &&
+         value != '?';
+}
+
+static constexpr bool is_octal_digit(int value) {
+  return value >= '0' && value <= '7';
+}
+
+/* printable characters stand for themselves, everything else becomes an
+ * octal escape (a hex escape would swallow any hex digit after it). an
+ * octal escape ends after three digits or at the first non octal digit,
+ * so the short form, \0 for the common zero, is only safe when no octal
+ * digit follows. padded always uses all three digits */
+static constexpr byte_table make_literal_table(bool padded) {
+  byte_table table{};
+  for (int value = 0; value < 256; value++) {
+    byte_text &entry = table[value];
+    if (is_plain(value)) {
+      entry.text[entry.length++] = char(value);
+      continue;
+    }
+    entry.text[entry.length++] = '\\';
+    if (padded || value >= 64)
+      entry.text[entry.length++] = char('0' + (value >> 6));
+    if (padded || value >= 8)
+      entry.text[entry.length++] = char('0' + ((value >> 3) & 7));
+    entry.text[entry.length++] = char('0' + (value & 7));
+  }
+  return table;
+}
+
+static constexpr byte_table decimal_table = make_decimal_table();
+static constexpr byte_table literal_table = make_literal_table(false);
+static constexpr byte_table padded_literal_table = make_literal_table(true);
+
+/* fixed size output buffer, flushed to the stream when full */
+class chunk_writer {
+public:
+  explicit chunk_writer(std::ostream &output) : _output(output) {}
+  ~chunk_writer() { flush(); }
+
+  void put(const char *text, std::size_t length) {
+    if (_used + length > _buffer.size())
+      flush();
+    std::memcpy(_buffer.data() + _used, text, length);
+    _used += length;
+  }
+
+  void flush() {
+    _output.write(_buffer.data(), _used);
+    _used = 0;
+  }
+
+private:
+  std::ostream &_output;
+  std::array<char, chunk_size> _buffer;
+  std::size_t _used = 0;
+};
+
+void encode_decimal_list(std::ostream &output, const std::uint8_t *data,
+                         std::size_t size) {
+  chunk_writer writer(output);
+  for (std::size_t i = 0; i < size; i++) {
+    const byte_text &entry = decimal_table[data[i]];
+    writer.put(entry.text, entry.length);
+  }
+}
+
+void encode_string_literal(std::ostream &output, const std::uint8_t *data,
+                           std::size_t size) {
+  chunk_writer writer(output);
+  writer.put("\"", 1);
+  std::size_t piece = 0;
+  for (std::size_t i = 0; i < size; i++) {
+    if (piece >= literal_piece) {
+      writer.put("\"\n\"", 3);
+      piece = 0;
+    }
+    const bool digit_follows = i + 1 < size && is_octal_digit(data[i + 1]);
+    const byte_text &entry = digit_follows ? padded_literal_table[data[i]]
+                                           : literal_table[data[i]];
+    writer.put(entry.text, entry.length);
+    piece += entry.length;
+  }
+  writer.put("\"", 1);
+}
@@ -0,0 +1,34 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_BYTE_ENCODER_H
+#define SILLY_PACKER_BYTE_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/* writes every byte as its decimal value followed by a comma, the body
+ * of a braced array initializer */
+void encode_decimal_list(std::ostream &output, const std::uint8_t *data,
+                         std::size_t size);
+
+/* writes the bytes as the body of a narrow string literal, quotes
+ * included. the literal is split into adjacent pieces on separate lines
+ * and, like every string literal, gets a terminating zero appended */
+void encode_string_literal(std::ostream &output, const std::uint8_t *data,
+                           std::size_t size);
+
+#endif
@@ -0,0 +1,143 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Greedy LZ4 block compressor. A block is a list of sequences, each a
+ * token byte (literal count in the high nibble, match length - 4 in the
+ * low one, 15 meaning more length bytes follow), the literals, and a two
+ * byte little endian offset back to the match. The block ends with a
+ * sequence of literals only. Spec:
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ */
+#include "compress.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+static constexpr std::size_t min_match = 4;
+/* the format requires the last 5 bytes to be literals and the last match
+ * to start at least 12 bytes before the end */
+static constexpr std::size_t last_literals = 5;
+static constexpr std::size_t match_find_limit = 12;
+static constexpr std::size_t max_offset = 65535;
+static constexpr int hash_log = 16;
+/* after 2^skip_strength misses in a row the search starts skipping
+ * ahead, incompressible data then goes through quickly */
+static constexpr int skip_strength = 6;
+
+static std::uint32_t load32(const std::uint8_t *p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static std::size_t hash_sequence(std::uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - hash_log);
+}
+
+static void write_length(std::vector<std::uint8_t> &out, std::size_t length) {
+  for (; length >= 255; length -= 255)
+    out.push_back(255);
+  out.push_back(static_cast<std::uint8_t>(length));
+}
+
+static void write_sequence(std::vector<std::uint8_t> &out,
+                           const std::uint8_t *literals,
+                           std::size_t literal_length, std::size_t offset,
+                           std::size_t match_length) {
+  const std::size_t match_code = match_length ? match_length - min_match : 0;
+  out.push_back(static_cast<std::uint8_t>(
+      (std::min<std::size_t>(literal_length, 15) << 4) |
+      std::min<std::size_t>(match_code, 15)));
+  if (literal_length >= 15)
+    write_length(out, literal_length - 15);
+  out.insert(out.end(), literals, literals + literal_length);
+  // the closing literal-only sequence has no offset
+  if (match_length == 0)
+    return;
+
+  out.push_back(static_cast<std::uint8_t>(offset & 0xff));
+  out.push_back(static_cast<std::uint8_t>(offset >> 8));
+  if (match_code >= 15)
+    write_length(out, match_code - 15);
+}
+
+std::vector<std::uint8_t> lz4_compress(const std::uint8_t *data,
+                                       std::size_t size) {
+  std::vector<std::uint8_t> out;
+  out.reserve(size + size / 255 + 16);
+
+  std::vector<std::size_t> table(std::size_t(1) << hash_log, 0);
+  std::size_t anchor = 0;
+  std::size_t i = 0;
+  std::size_t misses = 0;
+  while (i + match_find_limit <= size) {
+    const std::uint32_t sequence = load32(data + i);
+    std::size_t &slot = table[hash_sequence(sequence)];
+    const std::size_t candidate = slot;
+    slot = i;
+    if (candidate >= i || i - candidate > max_offset ||
+        load32(data + candidate) != sequence) {
+      i += 1 + (misses++ >> skip_strength);
+      continue;
+    }
+
+    std::size_t length = min_match;
+    while (i + length < size - last_literals &&
+           data[candidate + length] == data[i + length])
+      length++;
+
+    write_sequence(out, data + anchor, i - anchor, i - candidate, length);
+    i += length;
+    anchor = i;
+    misses = 0;
+    // seed the table inside the match so the next one can reach it
+    if (i + match_find_limit <= size)
+      table[hash_sequence(load32(data + i - 2))] = i - 2;
+  }
+
+  write_sequence(out, data + anchor, size - anchor, 0, 0);
+  return out;
+}
+
+std::string lz4_decompressor_source(std::string_view name) {
+  /* matches may overlap what they produce (offset smaller than length),
+   * those are copied byte by byte, everything else with memcpy */
+  // clang-format off
+  static const std::string parameters_and_body{
+    "(const std::uint8_t*source,std::size_t size,std::uint8_t*destination){"
+      "const std::uint8_t*const end=source+size;"
+      "const auto length=[&source](std::size_t value){"
+        "if(value==15){std::uint8_t more;"
+          "do{more=*source++;value+=more;}while(more==255);}"
+        "return value;"
+      "};"
+      "while(true){"
+        "const std::uint8_t token=*source++;"
+        "const std::size_t literals=length(token>>4);"
+        "std::memcpy(destination,source,literals);"
+        "destination+=literals;source+=literals;"
+        "if(source>=end)return;"
+        "const std::size_t offset=source[0]|(source[1]<<8);source+=2;"
+        "const std::size_t match=length(token&15)+4;"
+        "const std::uint8_t*from=destination-offset;"
+        "if(offset>=match)std::memcpy(destination,from,match);"
+        "else for(std::size_t i=0;i<match;i++)destination[i]=from[i];"
+        "destination+=match;"
+      "}"
+    "}"
+  };
+  // clang-format on
+  return std::format("inline void {}{}", name, parameters_and_body);
+}
@@ -0,0 +1,34 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_COMPRESS_H
+#define SILLY_PACKER_COMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* compresses data into a single LZ4 block (the raw block format, no frame
+ * header), which any LZ4 block decoder can read back */
+std::vector<std::uint8_t> lz4_compress(const std::uint8_t *data,
+                                       std::size_t size);
+
+/* source of the function called name that is written into compressed
+ * headers, it decodes the blocks made by lz4_compress() */
+std::string lz4_decompressor_source(std::string_view name);
+
+#endif
@@ -31,156 +31,166 @@
 #include <cstdint>
 #include <vector>
 
-using std::uint32_t;
-using rectangle_vector = std::vector<rectangle>;
-
-static rectangle_vector handle_overlaps_and_splits(const rectangle_vector &free,
-                                                   const rectangle &rect) {
-  rectangle_vector new_free = {};
-  for (const rectangle &free_rect : free) {
-    // we're not overlapping
-    if (!is_overlapping(free_rect, rect)) {
-      new_free.push_back(free_rect);
-      continue;
-    } // if
-
-    /* we are overlapping, and therefore we find the overlap region
-     * then make four sub rectangles based on that */
-    int overlap_x1 = std::max(free_rect.x, rect.x);
-    int overlap_y1 = std::max(free_rect.y, rect.y);
-    int overlap_x2 =
-        std::min(free_rect.x + free_rect.width, rect.x + rect.width);
-    int overlap_y2 =
-        std::min(free_rect.y + free_rect.height, rect.y + rect.height);
-
-    /* this also checks if there is an overlap
-     * this is repeat of is_overlap() but with the max x coord and min y coord
-     * of free rectangle and the current rectangle we are checking */
-    if (overlap_x1 >= overlap_x2 or overlap_y1 >= overlap_y2) {
-      new_free.push_back(free_rect);
-      continue;
-    }
+using std::int64_t;
+
+/* lower is better: the leftover area, short side or long side that
+ * remains in free once to_fit is placed in it */
+static int64_t fit_score(const rectangle &to_fit, const rectangle &free,
+                         fit_heuristic heuristic) {
+  const int64_t width_left = free.width - to_fit.width;
+  const int64_t height_left = free.height - to_fit.height;
+  switch (heuristic) {
+  case fit_heuristic::best_short_side_fit:
+    return std::min(width_left, height_left);
+  case fit_heuristic::best_long_side_fit:
+    return std::max(width_left, height_left);
+  default:
+    return int64_t(free.width) * free.height -
+           int64_t(to_fit.width) * to_fit.height;
+  }
+}
 
-    // above
-    if (overlap_y2 < free_rect.y + free_rect.height)
-      new_free.push_back({free_rect.x, overlap_y2, free_rect.width,
-                          (free_rect.y + free_rect.height) - overlap_y2});
-
-    // below
-    if (overlap_y1 > free_rect.y)
-      new_free.push_back({free_rect.x, free_rect.y, free_rect.width,
-                          overlap_y1 - free_rect.y});
-
-    // left
-    if (overlap_x1 > free_rect.x)
-      new_free.push_back({free_rect.x, overlap_y1, overlap_x1 - free_rect.x,
-                          overlap_y2 - overlap_y1});
-
-    // right
-    if (overlap_x2 < free_rect.x + free_rect.width)
-      new_free.push_back({overlap_x2, overlap_y1,
-                          (free_rect.x + free_rect.width) - overlap_x2,
-                          overlap_y2 - overlap_y1});
-  } // for free_rect in free
-
-  return new_free;
+/* cut the leftover of selection into two rectangles along the shorter
+ * leftover axis, this keeps the bigger of the two pieces as big as
+ * possible. the free rectangles never overlap */
+static void split(rectangle_vector &free_recs, const rectangle &selection,
+                  const rectangle &placed) {
+  const bool horizontal_cut = (selection.width - placed.width) <=
+                              (selection.height - placed.height);
+
+  // GUILLOTINE!!! OFF WITH THEIR HEADS!!!
+  rectangle bottom = {selection.x, selection.y + placed.height, placed.width,
+                      selection.height - placed.height};
+  rectangle right = {selection.x + placed.width, selection.y,
+                     selection.width - placed.width, placed.height};
+  if (horizontal_cut)
+    bottom.width = selection.width;
+  else
+    right.height = selection.height;
+
+  if (bottom.width > 0 && bottom.height > 0)
+    free_recs.push_back(bottom);
+  if (right.width > 0 && right.height > 0)
+    free_recs.push_back(right);
 }
 
-static rectangle_vector cleanup_splits(rectangle_vector free) {
-  rectangle_vector new_free = {};
-
-  for (int i = 0; i < free.size(); i++) {
-    bool keep_split = true;
-    for (int j = 0; j < free.size(); j++) {
-      if (i != j) {
-        if (containable(free[i], free[j])) {
-          keep_split = false;
-          break;
-        } // if containable
-      } // if i != j
-    } // for j
-
-    if (keep_split)
-      new_free.push_back(free[i]);
-  } // for i
-
-  // overlap cleanup
-  rectangle_vector result;
-  for (rectangle &rect : new_free) {
-    result = handle_overlaps_and_splits(result, rect);
-    result.push_back(rect);
+/* two free rectangles that share a whole edge become one */
+static bool try_merge(rectangle &into, const rectangle &other) {
+  if (into.x == other.x && into.width == other.width) {
+    if (into.y + into.height == other.y) {
+      into.height += other.height;
+      return true;
+    }
+    if (other.y + other.height == into.y) {
+      into.y = other.y;
+      into.height += other.height;
+      return true;
+    }
   }
+  if (into.y == other.y && into.height == other.height) {
+    if (into.x + into.width == other.x) {
+      into.width += other.width;
+      return true;
+    }
+    if (other.x + other.width == into.x) {
+      into.x = other.x;
+      into.width += other.width;
+      return true;
+    }
+  }
+  return false;
+}
 
-  return result;
+/* only the rectangles from the last split can have become mergeable,
+ * so each of them is checked against the list once more for every
+ * merge it takes part in instead of comparing all pairs */
+static void merge_new_splits(rectangle_vector &free_recs,
+                             std::size_t first_new) {
+  for (std::size_t i = first_new; i < free_recs.size(); i++) {
+    bool merged = true;
+    while (merged) {
+      merged = false;
+      for (std::size_t j = 0; j < free_recs.size(); j++) {
+        if (i == j || not try_merge(free_recs[i], free_recs[j]))
+          continue;
+        free_recs.erase(free_recs.begin() + j);
+        if (j < i)
+          i--;
+        merged = true;
+        break;
+      }
+    }
+  }
 }
 
 static rectangle_vector
 guillotine_pack_rectangles(int atlas_width, int atlas_height,
-                           std::vector<image<int>> rectangles) {
+                           const std::vector<image<int>> &rectangles,
+                           fit_heuristic heuristic, bool allow_rotate,
+                           bool partial) {
   rectangle_vector free_recs = {{0, 0, atlas_width, atlas_height}};
   rectangle_vector placed;
 
-  for (image<int> &to_fit : rectangles) {
-    rectangle selection = {};
-    int selection_index = invalid;
+  for (const image<int> &to_fit : rectangles) {
+    const rectangle wanted[2] = {
+        {0, 0, to_fit.width, to_fit.height},
+        {0, 0, to_fit.height, to_fit.width, true},
+    };
+    const int orientations =
+        (allow_rotate && to_fit.width != to_fit.height) ? 2 : 1;
+    int selection_index = invalid, selection_turn = 0;
+    int64_t best_score = 0;
 
     for (int i = 0; i < free_recs.size(); i++) {
-      rectangle cur = free_recs[i];
-      // NOTE: to_fit.x or image.x,y actually represent width, height
-      // and not co-ordinates
-      if (to_fit.width <= cur.width && to_fit.height <= cur.height) {
-        selection = cur;
-        selection_index = i;
-        break;
+      // the turned image only wins when it fits strictly better
+      for (int turn = 0; turn < orientations; turn++) {
+        if (not canfit(wanted[turn], free_recs[i]))
+          continue;
+
+        int64_t score = fit_score(wanted[turn], free_recs[i], heuristic);
+        if (selection_index == invalid || score < best_score) {
+          selection_index = i;
+          selection_turn = turn;
+          best_score = score;
+        }
       }
     } // for int i = 0
 
-    if (selection_index == invalid)
+    if (selection_index == invalid) {
+      // no point in placing the rest, this atlas size has failed
+      if (not partial)
+        return rectangle_vector{make_invalid_rectangle()};
+      placed.push_back(make_invalid_rectangle());
       continue;
+    }
 
-    placed.push_back({selection.x, selection.y, to_fit.width, to_fit.height});
-    free_recs.erase(free_recs.begin() + selection_index,
-                    free_recs.begin() + selection_index + 1);
-
-    // GUILLOTINE!!! OFF WITH THEIR HEADS!!!
-    rectangle right = {selection.x + to_fit.width, selection.y,
-                       selection.width - to_fit.width, selection.height};
-    rectangle bottom = {selection.x, selection.y + to_fit.height,
-                        selection.width, selection.height - to_fit.height};
-
-    if (right.width > 0 && right.height > 0)
-      free_recs.push_back(right);
-    if (bottom.width > 0 && bottom.height > 0)
-      free_recs.push_back(bottom);
-
-    free_recs = cleanup_splits(free_recs);
-
+    const rectangle selection = free_recs[selection_index];
+    const rectangle rect = {selection.x, selection.y,
+                            wanted[selection_turn].width,
+                            wanted[selection_turn].height,
+                            wanted[selection_turn].rotated};
+    placed.push_back(rect);
+    free_recs.erase(free_recs.begin() + selection_index);
+
+    const std::size_t first_new = free_recs.size();
+    split(free_recs, selection, rect);
+    merge_new_splits(free_recs, first_new);
   } // for all rectangles
   return placed;
 }
 
-atlas_properties guillotine(std::vector<image<int>> &images) {
+atlas_properties guillotine(std::vector<image<int>> &images,
+                            const packer_options &options) {
   // this sorts the images (rectangles) vector by whatever side is larger
-  std::sort(images.begin(), images.end(),
-            [](const image<int> &img1, const image<int> &img2) {
-              return std::max(img1.width, img1.height) >
-                     std::max(img2.width, img2.height);
-            });
-
-  uint32_t atlas_width = closest_power_of_two(calculate_min_side(images)),
-           atlas_height = closest_power_of_two(calculate_min_side(images));
-
-  // we will return hopefully
-  while (true) {
-    std::vector<rectangle> placed_rectangles =
-        guillotine_pack_rectangles(atlas_width, atlas_height, images);
-    if (placed_rectangles.size() == images.size())
-      return {atlas_width, atlas_height, placed_rectangles};
-
-    // grow the atlas if we can't fit
-    if (atlas_width <= atlas_height)
-      atlas_width *= 2;
-    else
-      atlas_height *= 2;
-  }
+  sort_images(images, options.sort.value_or(sort_order::max_side));
+
+  return search_atlas_size(
+      images,
+      [&options](int width, int height,
+                 const std::vector<image<int>> &rectangles, bool partial) {
+        return guillotine_pack_rectangles(width, height, rectangles,
+                                          options.heuristic,
+                                          options.allow_rotate, partial);
+      },
+      options);
 }
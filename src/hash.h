@@ -0,0 +1,66 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_HASH_H
+#define SILLY_PACKER_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* a non-cryptographic 64 bit hash, only used to bucket content
+ * so every match still has to be confirmed with a full compare.
+ * four independent lanes eat 32 bytes per round, the finalizer
+ * is the one from MurmurHash3 */
+inline std::uint64_t hash_mix(std::uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+inline std::uint64_t content_hash(const void *data, std::size_t size,
+                                  std::uint64_t seed = 0) {
+  constexpr std::uint64_t prime1 = 0x9e3779b185ebca87ull;
+  constexpr std::uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+  auto rotl = [](std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+  auto load = [](const unsigned char *p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  };
+
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  std::uint64_t lane[4] = {seed + prime1 + prime2, seed + prime2, seed,
+                           seed - prime1};
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int l = 0; l < 4; l++)
+      lane[l] = rotl(lane[l] + load(bytes + i + l * 8) * prime2, 31) * prime1;
+  }
+
+  std::uint64_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) +
+                    rotl(lane[3], 18) + size;
+  for (; i + 8 <= size; i += 8)
+    h = rotl(h ^ (rotl(load(bytes + i) * prime2, 31) * prime1), 27) * prime1;
+  for (; i < size; i++)
+    h = rotl(h ^ (bytes[i] * prime1), 11) * prime2;
+
+  return hash_mix(h);
+}
+
+#endif
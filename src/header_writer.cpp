@@ -14,23 +14,62 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "header_writer.h"
+#include "byte_encoder.h"
+#include "compress.h"
+#include "mapped_file.h"
+#include <cctype>
+#include <cstring>
 #include <format>
-#include <sstream>
 #include <stdexcept>
 
+/* silly_packer_<header stem>_<name>, for symbols that may end up at
+ * global scope and are not named after an input, so they clash neither
+ * with another generated header nor with the including project */
+static std::string header_symbol(const std::filesystem::path &header,
+                                 std::string_view name) {
+  std::string symbol =
+      std::format("silly_packer_{}_{}", header.stem().string(), name);
+  for (char &c : symbol) {
+    if (not std::isalnum(static_cast<unsigned char>(c)))
+      c = '_';
+  }
+  return symbol;
+}
+
 header_writer::header_writer(const std::filesystem::path &path,
                              const std::string &guard,
-                             const std::string &spacename, bool use_raylib)
+                             const std::string &spacename, bool use_raylib,
+                             payload_mode payload, bool split_data,
+                             bool compress)
     : _fstream(path), _header_path(path), _using_raylib(use_raylib),
-      _has_namespace(false) {
+      _has_namespace(false), _payload(payload), _compress(compress) {
   if (!_fstream.is_open()) {
     throw std::runtime_error("Could not open file");
   }
+  _written_files.push_back(path);
+
+  if (split_data) {
+    _data_path = path;
+    _data_path.replace_extension(".cpp");
+    _data_fstream.open(_data_path);
+    if (!_data_fstream.is_open()) {
+      throw std::runtime_error("Could not open file");
+    }
+    _written_files.push_back(_data_path);
+    _data_fstream << std::format("#include \"{}\"\n",
+                                 path.filename().string());
+    if (spacename != "")
+      _data_fstream << std::format("namespace {} {{", spacename);
+  }
 
   write(std::format("#ifndef {0}\n#define {0}\n", guard));
   write("#include<array>\n");
   write("#include <cstdint>\n");
   write("#include <cstddef>\n");
+  if (_payload == payload_mode::string || _payload == payload_mode::incbin)
+    write("#include <span>\n");
+  if (_compress)
+    write("#include <cstring>\n");
   _byte_type = "std::uint8_t";
 
   if (_using_raylib)
@@ -40,6 +79,9 @@ header_writer::header_writer(const std::filesystem::path &path,
     write(std::format("namespace {} {{", spacename));
     _has_namespace = true;
   }
+
+  if (_compress)
+    write(lz4_decompressor_source(header_symbol(path, "decompress")));
 }
 
 header_writer::~header_writer() { header_writer::close(); }
@@ -50,10 +92,21 @@ bool header_writer::using_raylib() const { return _using_raylib; }
 
 bool header_writer::using_namespace() const { return _has_namespace; }
 
+bool header_writer::compressing() const { return _compress; }
+
 const std::string &header_writer::byte_type() const { return _byte_type; }
 
 std::filesystem::path header_writer::get_path() const { return _header_path; }
 
+std::filesystem::path header_writer::get_data_path() const {
+  return _data_path;
+}
+
+const std::vector<std::filesystem::path> &
+header_writer::written_files() const {
+  return _written_files;
+}
+
 void header_writer::write(const std::string &data) {
   _fstream.write(data.c_str(), data.size());
 }
@@ -69,32 +122,163 @@ void header_writer::write_variable(const std::string &type,
   write(std::format("{}{} {}={};", constant_string, type_string, name, value));
 }
 
+/* <header stem>_<name>.bin next to the header. a sidecar that already
+ * holds exactly these bytes is left alone, its unchanged timestamp keeps
+ * build systems from re-embedding or re-assembling it */
+std::filesystem::path header_writer::write_sidecar(const std::string &name,
+                                                   const std::uint8_t *data,
+                                                   std::size_t size) {
+  std::filesystem::path sidecar = _header_path;
+  sidecar.replace_filename(
+      std::format("{}_{}.bin", _header_path.stem().string(), name));
+  _written_files.push_back(sidecar);
+  {
+    mapped_file existing(sidecar);
+    if (existing.is_open() && existing.size() == size &&
+        (size == 0 || std::memcmp(existing.data(), data, size) == 0))
+      return sidecar;
+  }
+
+  std::ofstream output(sidecar, std::ios::binary);
+  if (!output.is_open()) {
+    throw std::runtime_error("Could not open file");
+  }
+  output.write(reinterpret_cast<const char *>(data), size);
+  return sidecar;
+}
+
+/* writes the start of a variable definition up to and including the '='
+ * and returns the stream its initializer and ';' go to. normally that is
+ * an inline variable in the header, when splitting the header gets an
+ * extern declaration and the definition goes to the data file */
+std::ostream &header_writer::begin_definition(const std::string &declaration,
+                                              bool constant) {
+  if (not _data_fstream.is_open()) {
+    write(std::format("{}inline {}=", constant ? "constexpr " : "",
+                      declaration));
+    return _fstream;
+  }
+  write(std::format("extern {}{};", constant ? "const " : "", declaration));
+  _data_fstream << std::format("{}{}=", constant ? "const " : "", declaration);
+  return _data_fstream;
+}
+
 void header_writer::write_byte_array(const std::string &name,
                                      const std::uint8_t *data, std::size_t size,
                                      bool constant) {
-  std::stringstream bytes_stream;
-  for (std::size_t i = 0; i < size; i++) {
-    bytes_stream << static_cast<unsigned int>(data[i]) << ',';
+  if (not _compress) {
+    write_payload(name, data, size, constant);
+    return;
   }
 
-  std::string constant_string = "";
-  if (constant) {
-    constant_string = "constexpr ";
+  /* the caller supplies a buffer of <name>_size bytes to decompress into */
+  const std::vector<std::uint8_t> compressed = lz4_compress(data, size);
+  const std::string compressed_name = std::format("{}_compressed", name);
+  write_payload(compressed_name, compressed.data(), compressed.size(),
+                constant);
+  write(std::format("inline constexpr std::size_t {0}_size={1};"
+                    "inline void decompress_{0}(std::uint8_t*destination){{"
+                    "{3}({2}.data(),{2}.size(),destination);}}",
+                    name, size, compressed_name,
+                    header_symbol(_header_path, "decompress")));
+}
+
+/* emits the bytes as they are, in the selected payload mode */
+void header_writer::write_payload(const std::string &name,
+                                  const std::uint8_t *data, std::size_t size,
+                                  bool constant) {
+  if (_payload == payload_mode::embed) {
+    /* #embed has to sit on a line of its own and is looked up relative
+     * to the file it is in, the sidecar is written right next to it */
+    std::filesystem::path sidecar = write_sidecar(name, data, size);
+    begin_definition(std::format("std::array<{},{}> {}", _byte_type, size, name),
+                     constant)
+        << std::format("{{\n#embed \"{}\"\n}};",
+                       sidecar.filename().string());
+    return;
+  }
+  if (_payload == payload_mode::incbin) {
+    /* the bytes live in read-only data of the object assembled from the
+     * stub, a span keeps .data() and .size() working like the array */
+    std::filesystem::path sidecar = write_sidecar(name, data, size);
+    const std::string symbol = header_symbol(_header_path, name);
+    _incbin_payloads.emplace_back(symbol, sidecar.filename().string());
+    write(std::format("extern \"C\" const {0} {1}[];"
+                      "inline constexpr std::span<const {0},{2}> {3}{{{1},{2}}};",
+                      _byte_type, symbol, size, name));
+    return;
+  }
+
+  if (_payload == payload_mode::string) {
+    /* a string literal needs room for its terminating zero, the span
+     * leaves it out again */
+    const std::string storage = std::format("silly_packer_literal_{}", name);
+    std::ostream &output = begin_definition(
+        std::format("{} {}[{}]", _byte_type, storage, size + 1), constant);
+    encode_string_literal(output, data, size);
+    output << ';';
+    write(std::format("{}inline std::span<{}{},{}> {}{{{},{}}};",
+                      constant ? "constexpr " : "", constant ? "const " : "",
+                      _byte_type, size, name, storage, size));
+    return;
   }
-  std::string type_string =
-      std::format("inline std::array<{},{}>", _byte_type, size);
-  write(std::format("{}{} {}={{{}}};", constant_string, type_string, name,
-                    bytes_stream.str()));
+
+  std::ostream &output = begin_definition(
+      std::format("std::array<{},{}> {}", _byte_type, size, name), constant);
+  output << '{';
+  encode_decimal_list(output, data, size);
+  output << "};";
+}
+
+/* <header stem>_payload.S, assemble it with the sidecars on the include
+ * path (-I) and link the object in */
+void header_writer::write_assembly_stub() {
+  std::filesystem::path stub = _header_path;
+  stub.replace_filename(
+      std::format("{}_payload.S", _header_path.stem().string()));
+  std::ofstream output(stub);
+  if (!output.is_open()) {
+    throw std::runtime_error("Could not open file");
+  }
+  _written_files.push_back(stub);
+
+  output << "/* generated by silly_packer, payloads of "
+         << _header_path.filename().string() << " */\n"
+         << "#if defined(__APPLE__)\n"
+            "#define SYMBOL(name) _##name\n"
+            "  .const\n"
+            "#else\n"
+            "#define SYMBOL(name) name\n"
+            "  .section .rodata\n"
+            "#endif\n";
+  for (const auto &[symbol, sidecar] : _incbin_payloads) {
+    output << std::format("  .global SYMBOL({0})\n"
+                          "  .balign 16\n"
+                          "SYMBOL({0}):\n"
+                          "  .incbin \"{1}\"\n",
+                          symbol, sidecar);
+  }
+  output << "#if defined(__ELF__)\n"
+            "  .section .note.GNU-stack,\"\",%progbits\n"
+            "#endif\n";
 }
 
 void header_writer::close() {
   // prevent double destruction
   if (!_is_closed) {
+    if (_payload == payload_mode::incbin)
+      write_assembly_stub();
     if (_has_namespace) {
       write("}");
     }
     write("\n#endif");
     _fstream.close();
+    if (_data_fstream.is_open()) {
+      if (_has_namespace)
+        _data_fstream << '}';
+      _data_fstream << '\n';
+      _data_fstream.close();
+    }
     _is_closed = true;
   }
 }
@@ -16,21 +16,59 @@
 #ifndef SILLY_PACKER_HEADER_WRITER_H
 #define SILLY_PACKER_HEADER_WRITER_H
 
+#include <array>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+/* how write_byte_array() emits the bytes. array spells them out as a
+ * list of numbers, string as one string literal that compilers parse a
+ * lot faster. the other modes write them to a <header>_<name>.bin
+ * sidecar: embed pulls that in with #embed, incbin declares an external
+ * symbol that a generated <header>_payload.S assembles from the sidecars */
+enum class payload_mode {
+  array,
+  string,
+  embed,
+  incbin,
+};
+
+inline constexpr std::array<std::pair<std::string_view, payload_mode>, 4>
+    payload_mode_names{{
+        {"array", payload_mode::array},
+        {"string", payload_mode::string},
+        {"embed", payload_mode::embed},
+        {"incbin", payload_mode::incbin},
+    }};
+
+/* with split_data the byte arrays are only declared in the header and
+ * defined in a <header stem>.cpp next to it, so that the megabytes of
+ * data are compiled once instead of in every includer. with compress
+ * every byte array <name> is stored LZ4 compressed as <name>_compressed,
+ * next to <name>_size and a decompress_<name>() that unpacks it */
 class header_writer {
 public:
   header_writer(const std::filesystem::path &path, const std::string &guard,
-                const std::string &spacename = "", bool use_raylib = false);
+                const std::string &spacename = "", bool use_raylib = false,
+                payload_mode payload = payload_mode::array,
+                bool split_data = false, bool compress = false);
   ~header_writer();
 
   bool is_open() const;
   bool using_raylib() const;
   bool using_namespace() const;
+  bool compressing() const;
   const std::string &byte_type() const;
   std::filesystem::path get_path() const;
+  /* empty unless the data is split out */
+  std::filesystem::path get_data_path() const;
+  /* every file the writer produced: the header, the data file, sidecars
+   * and the assembly stub. complete once the writer is closed */
+  const std::vector<std::filesystem::path> &written_files() const;
 
   void write(const std::string &data);
   void write_variable(const std::string &type, const std::string &name,
@@ -41,11 +79,27 @@ public:
   void close();
 
 private:
+  std::filesystem::path write_sidecar(const std::string &name,
+                                      const std::uint8_t *data,
+                                      std::size_t size);
+  void write_assembly_stub();
+  void write_payload(const std::string &name, const std::uint8_t *data,
+                     std::size_t size, bool constant);
+  std::ostream &begin_definition(const std::string &declaration,
+                                 bool constant);
+
   std::ofstream _fstream;
   std::filesystem::path _header_path;
+  std::ofstream _data_fstream;
+  std::filesystem::path _data_path;
   bool _using_raylib;
   bool _has_namespace;
   std::string _byte_type;
+  payload_mode _payload;
+  bool _compress;
+  /* symbol and sidecar file of every incbin payload, for the .S stub */
+  std::vector<std::pair<std::string, std::string>> _incbin_payloads;
+  std::vector<std::filesystem::path> _written_files;
   bool _is_closed = false;
 };
 
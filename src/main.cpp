@@ -13,11 +13,23 @@
  * You should have received a copy of the GNU Affero General Public License
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
+#include "block_encoder.h"
+#include "build_cache.h"
+#include "hash.h"
 #include "header_writer.h"
+#include "mapped_file.h"
+#include "mipmap.h"
 #include "packer.h"
+#include "parallel.h"
+#include "perfect_hash.h"
+#include "png_writer.h"
+#include "rectangle_checks.h"
+#include "texture_file.h"
+#include "trim.h"
 
 #include <algorithm>
 #include <argparse/argparse.hpp>
+#include <cstdio>
 #include <cstring>
 #include <format>
 #include <fstream>
@@ -25,6 +37,8 @@
 #include <stb_image.h>
 #include <stb_image_resize2.h>
 #include <stb_image_write.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 struct packer_args : public argparse::Args {
@@ -46,12 +60,21 @@ struct packer_args : public argparse::Args {
           .set_default("silly_packer");
   std::string &algorithm =
       kwarg("a,algorithm",
-            "Use one of these algorithms to pack: maxrects, guillotine")
+            "Use one of these algorithms to pack: maxrects, guillotine, "
+            "skyline, auto")
           .set_default("maxrects");
   bool &raylib_utils =
       kwarg("r,raylib", "Enable raylib utility functions").set_default(false);
   bool &generate_png =
       kwarg("p,png", "Generate an output png image").set_default(false);
+  int &png_level =
+      kwarg("png-level", "Compression of the png: 0 stores it, 1 to 3 compress "
+                         "strips in parallel, 4 to 9 use stb_image_write")
+          .set_default(8);
+  std::string &format =
+      kwarg("format", "Also write every atlas page as a ktx2, dds or qoi file, "
+                      "with the sprites in a binary .sprites file")
+          .set_default("");
   bool &duplicates =
       kwarg("d,duplicates",
             "Allow duplicate file inputs to be part of the atlas")
@@ -59,11 +82,87 @@ struct packer_args : public argparse::Args {
   bool &debug =
       kwarg("debug", "Export extra symbols that can be used for debugging")
           .set_default(false);
+  int &jobs = kwarg("j,jobs", "Number of worker threads, 0 uses all cores")
+                  .set_default(0);
+  int &size_step =
+      kwarg("s,size-step",
+            "Atlas sides are multiples of this, 0 keeps them powers of two")
+          .set_default(0);
+  std::string &heuristic =
+      kwarg("H,heuristic",
+            "Free rectangle choice: baf, bssf, blsf, bl, cp (maxrects) or "
+            "baf, bssf, blsf (guillotine), empty picks baf")
+          .set_default("");
+  bool &trim = kwarg("t,trim", "Pack only the non-transparent part of images")
+                   .set_default(false);
+  bool &allow_rotate =
+      kwarg("allow-rotate", "Let the packer turn images by 90 degrees")
+          .set_default(false);
+  std::string &max_size =
+      kwarg("m,max-size", "Largest atlas page as WxH, images that do not fit "
+                          "spill onto more pages, empty packs a single page")
+          .set_default("");
+  std::string &payload =
+      kwarg("payload", "How pixel and extra file bytes are emitted: array, "
+                       "embed (#embed of a .bin), incbin (.S stub and .bin)")
+          .set_default("array");
+  bool &split =
+      kwarg("split", "Declare the byte arrays in the header and define them "
+                     "in a .cpp next to it")
+          .set_default(false);
+  bool &compress =
+      kwarg("c,compress", "Store byte arrays LZ4 compressed, with a generated "
+                          "decompressor")
+          .set_default(false);
+  std::string &texture =
+      kwarg("texture", "Texture format of the atlas: rgba8, bc1, bc3, bc7 "
+                       "(block compressed, sprites placed on 4x4 blocks)")
+          .set_default("rgba8");
+  int &padding =
+      kwarg("padding", "Pixels around every sprite filled with copies of its "
+                       "edge pixels")
+          .set_default(0);
+  bool &mipmaps =
+      kwarg("mipmaps", "Generate the mip chain of every atlas page")
+          .set_default(false);
+  std::string &sort =
+      kwarg("sort", "Image order: area, perimeter, max-side, width, height, "
+                    "empty picks the algorithm's own")
+          .set_default("");
+  bool &cache =
+      kwarg("cache", "Keep a <out>.cache next to the header and skip the "
+                     "work an earlier run already did")
+          .set_default(false);
+  bool &low_memory =
+      kwarg("low-memory", "Read only image sizes for packing and decode every "
+                          "image when it is copied into the atlas, identical "
+                          "images are found by their file bytes")
+          .set_default(false);
+  bool &stable =
+      kwarg("stable", "Keep sprites where the last run put them and fit new "
+                      "or resized ones around them, implies --cache")
+          .set_default(false);
+  int &repack_below =
+      kwarg("repack-below", "With --stable, pack from scratch once less than "
+                            "this percent of the atlas is covered")
+          .set_default(0);
 };
 
 inline std::vector<image<int>> images;
-inline image<unsigned int> atlas;
-inline std::vector<std::uint8_t> atlas_data;
+/* inputs that are pixel-identical to an entry of images, their data
+ * points at the pixels of that entry and is never freed on its own */
+inline std::vector<image<int>> image_aliases;
+/* path of the entry of images that each alias shares */
+inline std::vector<std::filesystem::path> image_alias_originals;
+/* one entry per atlas page, the image data points into atlas_data */
+inline std::vector<image<unsigned int>> atlas_pages;
+inline std::vector<std::vector<std::uint8_t>> atlas_data;
+/* layout of atlas_data, block compressed formats replace the pixels */
+inline block_format atlas_format = block_format::rgba8;
+/* where every mip level starts in atlas_data, one entry per page */
+inline std::vector<std::vector<std::size_t>> atlas_mip_offsets;
+/* the atlas pngs and texture files written by --png and --format */
+inline std::vector<std::filesystem::path> atlas_image_files;
 
 void get_sanitized_name(std::string &output, const std::string_view &filename,
                         const bool using_namespace) {
@@ -93,42 +192,193 @@ void sanitize_image_filename(image<int> &img, const std::string_view &filename,
   }());
 }
 
-void check_image_duplicates(const std::string_view &name, bool duplicates) {
-  for (const image<int> &img : images) {
-    if (img.filename.stem() == std::filesystem::path(name).stem()) {
-      std::cerr << std::format("File '{}' alread loaded. Exiting\n", name);
-      std::exit(1);
-    }
+void check_image_duplicates(const std::string_view &name,
+                            std::unordered_set<std::string> &loaded_stems) {
+  if (not loaded_stems.insert(std::filesystem::path(name).stem().string())
+              .second) {
+    std::cerr << std::format("File '{}' alread loaded. Exiting\n", name);
+    std::exit(1);
+  }
+}
+
+/* --low-memory keeps no pixels, so a hash match is confirmed against the
+ * files: their bytes, or with --trim (which hashed the decoded pixels)
+ * the pixels decoded once more */
+bool same_file_content(const image<int> &a, const image<int> &b, bool trim) {
+  if (trim) {
+    int width, height, comps;
+    std::uint8_t *first = stbi_load(a.fullpath.string().c_str(), &width,
+                                    &height, &comps, STBIR_RGBA);
+    std::uint8_t *second = stbi_load(b.fullpath.string().c_str(), &width,
+                                     &height, &comps, STBIR_RGBA);
+    const bool same =
+        first != nullptr && second != nullptr &&
+        a.source_width == b.source_width &&
+        a.source_height == b.source_height &&
+        std::memcmp(first, second,
+                    std::size_t(a.source_width) * a.source_height *
+                        STBIR_RGBA) == 0;
+    stbi_image_free(first);
+    stbi_image_free(second);
+    return same;
   }
+  mapped_file first(a.fullpath), second(b.fullpath);
+  return first.is_open() && second.is_open() &&
+         first.size() == second.size() &&
+         std::memcmp(first.data(), second.data(), first.size()) == 0;
 }
 
-void load_image(const char *name, bool duplicates, const bool using_namespace) {
-  // check for repeats and skip
-  if (duplicates == false) {
-    check_image_duplicates(name, duplicates);
+/* returns the index into images of an image with exactly the same pixels,
+ * or invalid if this content has not been seen yet */
+int find_identical_image(
+    const image<int> &img, std::uint64_t hash, bool trim,
+    std::unordered_map<std::uint64_t, std::vector<int>> &loaded_content) {
+  std::vector<int> &candidates = loaded_content[hash];
+  for (int index : candidates) {
+    const image<int> &other = images[index];
+    if (other.width == img.width && other.height == img.height &&
+        (img.data == nullptr
+             ? same_file_content(other, img, trim)
+             : std::memcmp(other.data, img.data,
+                           std::size_t(img.width) * img.height *
+                               STBIR_RGBA) == 0))
+      return index;
   }
+  candidates.push_back(images.size());
+  return -1;
+}
+
+/* the part of loading an image that is safe to run on a worker thread,
+ * everything that prints or exits is left to load_images() */
+struct decoded_image {
+  image<int> img;
+  std::uint64_t hash = 0;
+  const char *failure_reason = nullptr;
+};
 
-  image<int> img{};
+void decode_image(const char *name, decoded_image &decoded) {
+  image<int> &img = decoded.img;
   img.filename = std::filesystem::path(name).filename();
   img.fullpath = std::filesystem::path(name);
   img.data = stbi_load(name, &img.width, &img.height, &img.components_per_pixel,
                        STBIR_RGBA);
   if (img.data == nullptr) {
-    std::cerr << std::format("{0}(): failed to load image: {1}: {2}\n",
-                             __func__, name, stbi_failure_reason());
-    std::cerr << "Exiting\n";
-    std::exit(1);
+    decoded.failure_reason = stbi_failure_reason();
+    return;
   }
+  img.source_width = img.width;
+  img.source_height = img.height;
+  decoded.hash = content_hash(
+      img.data, std::size_t(img.width) * img.height * STBIR_RGBA,
+      (std::uint64_t(img.width) << 32) | std::uint32_t(img.height));
+}
 
-  sanitize_image_filename(img, img.filename.stem().string(), using_namespace);
-  if (img.components_per_pixel != STBIR_RGBA) {
-    std::cout << std::format(
-        "image '{}': was not RGBA originally but has been converted to RGBA\n",
-        img.filename.filename().string());
-    img.components_per_pixel = STBIR_RGBA;
+/* --low-memory: only the size is read and the file bytes are hashed,
+ * the pixels are decoded again when they are copied into the atlas.
+ * trimming needs them, so those images are decoded, trimmed and freed */
+void probe_image(const char *name, bool trim, decoded_image &decoded) {
+  image<int> &img = decoded.img;
+  if (trim) {
+    decode_image(name, decoded);
+    if (img.data == nullptr)
+      return;
+    trim_image(img);
+    stbi_image_free(img.data);
+    img.data = nullptr;
+    return;
   }
 
-  images.push_back(img);
+  img.filename = std::filesystem::path(name).filename();
+  img.fullpath = std::filesystem::path(name);
+  if (not stbi_info(name, &img.width, &img.height,
+                    &img.components_per_pixel)) {
+    decoded.failure_reason = stbi_failure_reason();
+    return;
+  }
+  img.source_width = img.width;
+  img.source_height = img.height;
+  mapped_file file(name);
+  if (not file.is_open()) {
+    decoded.failure_reason = std::strerror(file.error());
+    return;
+  }
+  decoded.hash = content_hash(
+      file.data(), file.size(),
+      (std::uint64_t(img.width) << 32) | std::uint32_t(img.height));
+}
+
+void load_images(const std::vector<std::string> &image_files, bool duplicates,
+                 const bool using_namespace, bool trim, bool low_memory,
+                 unsigned int jobs) {
+  std::vector<decoded_image> decoded(image_files.size());
+  parallel_for(image_files.size(), jobs, [&](std::size_t i) {
+    if (low_memory)
+      probe_image(image_files[i].c_str(), trim, decoded[i]);
+    else
+      decode_image(image_files[i].c_str(), decoded[i]);
+  });
+
+  std::unordered_set<std::string> loaded_stems;
+  std::unordered_map<std::uint64_t, std::vector<int>> loaded_content;
+
+  /* walk the results in input order so that diagnostics and the
+   * order of the images vector do not depend on thread scheduling */
+  for (int i = 0; i < image_files.size(); i++) {
+    const char *name = image_files[i].c_str();
+    // check for repeats and skip
+    if (duplicates == false) {
+      check_image_duplicates(name, loaded_stems);
+    }
+
+    image<int> &img = decoded[i].img;
+    if (decoded[i].failure_reason != nullptr) {
+      std::cerr << std::format("{0}(): failed to load image: {1}: {2}\n",
+                               __func__, name, decoded[i].failure_reason);
+      std::cerr << "Exiting\n";
+      std::exit(1);
+    }
+
+    sanitize_image_filename(img, img.filename.stem().string(), using_namespace);
+    if (img.components_per_pixel != STBIR_RGBA) {
+      std::cout << std::format("image '{}': was not RGBA originally but has "
+                               "been converted to RGBA\n",
+                               img.filename.filename().string());
+      img.components_per_pixel = STBIR_RGBA;
+    }
+
+    /* identical pixels are packed once, the alias still gets its own
+     * name in the header but shares the sprite_info of the original */
+    int identical = find_identical_image(img, decoded[i].hash, trim,
+                                         loaded_content);
+    if (identical != -1) {
+      std::cout << std::format("image '{}': is identical to '{}' and will "
+                               "share its sprite\n",
+                               img.filename.string(),
+                               images[identical].filename.string());
+      stbi_image_free(img.data);
+      img.data = images[identical].data;
+      image_aliases.push_back(img);
+      image_alias_originals.push_back(images[identical].fullpath);
+      continue;
+    }
+
+    images.push_back(img);
+  }
+}
+
+/* images are reordered by the packers, so aliases are resolved by
+ * the path of the image they share rather than by position. an image
+ * with the same pixels as an earlier one never makes it into images,
+ * so its paths are unique */
+std::vector<int> resolve_alias_indices() {
+  std::unordered_map<std::string, int> index_of;
+  for (int i = 0; i < images.size(); i++)
+    index_of[images[i].fullpath.string()] = i;
+
+  std::vector<int> indices;
+  for (const std::filesystem::path &original : image_alias_originals)
+    indices.push_back(index_of.at(original.string()));
+  return indices;
 }
 
 void cleanup_stb_images() {
@@ -136,12 +386,134 @@ void cleanup_stb_images() {
     stbi_image_free(img.data);
 }
 
+/* puts the images back into the order and places of an earlier run.
+ * only works when the same set of images comes back at the same packed
+ * sizes, otherwise the layout is useless and false is returned */
+bool reuse_layout(const build_cache &cache, atlas_properties &atlas_p) {
+  if (cache.sprites.size() != images.size() || cache.pages.empty())
+    return false;
+
+  std::unordered_map<std::string, int> index_of;
+  for (int i = 0; i < images.size(); i++)
+    index_of[images[i].fullpath.string()] = i;
+  if (index_of.size() != images.size())
+    return false;
+
+  std::vector<int> order;
+  for (const cached_sprite &sprite : cache.sprites) {
+    auto found = index_of.find(sprite.path);
+    if (found == index_of.end())
+      return false;
+    const image<int> &img = images[found->second];
+    if (img.width != sprite.width || img.height != sprite.height ||
+        img.offset_x != sprite.offset_x || img.offset_y != sprite.offset_y ||
+        img.source_width != sprite.source_width ||
+        img.source_height != sprite.source_height ||
+        sprite.rect.page < 0 || sprite.rect.page >= cache.pages.size())
+      return false;
+    order.push_back(found->second);
+  }
+
+  std::vector<image<int>> reordered;
+  for (int index : order)
+    reordered.push_back(images[index]);
+  images.swap(reordered);
+
+  atlas_p.pages = cache.pages;
+  atlas_p.rectangles.clear();
+  for (const cached_sprite &sprite : cache.sprites)
+    atlas_p.rectangles.push_back(sprite.rect);
+  return true;
+}
+
+/* --stable: images the last run packed at the same size keep their place
+ * and their index, new and resized ones are fitted around them. false
+ * when they do not fit or cover less than repack_below percent */
+bool warm_start(const build_cache &cache, const packer_options &options,
+                int repack_below, atlas_properties &atlas_p) {
+  if (cache.pages.empty())
+    return false;
+
+  std::unordered_map<std::string, int> index_of;
+  for (int i = 0; i < images.size(); i++)
+    index_of[images[i].fullpath.string()] = i;
+  if (index_of.size() != images.size())
+    return false;
+
+  /* the images of the last run in its order, then the new ones */
+  std::vector<image<int>> ordered;
+  std::vector<bool> taken(images.size(), false);
+  atlas_properties previous{
+      .pages = cache.pages, .rectangles = {}, .filename = {}};
+  int kept = 0;
+  for (const cached_sprite &sprite : cache.sprites) {
+    auto found = index_of.find(sprite.path);
+    if (found == index_of.end() || taken[found->second])
+      continue;
+    const image<int> &img = images[found->second];
+    taken[found->second] = true;
+    const bool same_size = img.width == sprite.width &&
+                           img.height == sprite.height &&
+                           sprite.rect.page >= 0 &&
+                           sprite.rect.page < cache.pages.size();
+    ordered.push_back(img);
+    previous.rectangles.push_back(same_size ? sprite.rect
+                                            : make_invalid_rectangle());
+    kept += same_size;
+  }
+  for (int i = 0; i < images.size(); i++) {
+    if (taken[i])
+      continue;
+    ordered.push_back(images[i]);
+    previous.rectangles.push_back(make_invalid_rectangle());
+  }
+
+  atlas_properties placed = maxrects_warm_start(ordered, previous, options);
+  if (placed.pages.empty()) {
+    std::cout << "The last layout has no room for the new images, "
+                 "packing from scratch\n";
+    return false;
+  }
+  std::uint64_t covered = 0, total = 0;
+  for (const image<int> &img : ordered)
+    covered += std::uint64_t(img.width) * img.height;
+  for (const atlas_page &page : placed.pages)
+    total += std::uint64_t(page.width) * page.height;
+  if (covered * 100 < total * repack_below) {
+    std::cout << std::format("The last layout is only {}% covered, packing "
+                             "from scratch\n",
+                             covered * 100 / total);
+    return false;
+  }
+
+  images.swap(ordered);
+  atlas_p = std::move(placed);
+  std::cout << std::format("Kept {} of {} images where they were\n", kept,
+                           images.size());
+  return true;
+}
+
+/* what the last --cache run left for this one to start from */
+struct layout_hint {
+  const build_cache *cache = nullptr;
+  /* the options are the same, so are the images at the same sizes */
+  bool exact = false;
+  bool stable = false;
+  int repack_below = 0;
+};
+
 atlas_properties
 pack_images_to_rectangles(std::vector<std::string> &image_files,
                           std::string &algorithm, bool duplicates,
-                          const bool using_namespace) {
-  for (int i = 0; i < image_files.size(); i++) {
-    load_image(image_files[i].c_str(), duplicates, using_namespace);
+                          const bool using_namespace, bool trim,
+                          bool low_memory, const packer_options &options,
+                          const layout_hint &hint) {
+  load_images(image_files, duplicates, using_namespace, trim, low_memory,
+              options.jobs);
+  // --low-memory trims while probing, the pixels are gone by now
+  if (trim && not low_memory) {
+    parallel_for(images.size(), options.jobs,
+                 [](std::size_t i) { trim_image(images[i]); });
   }
 
   /* this sorts our images vector in accordance with
@@ -151,33 +523,112 @@ pack_images_to_rectangles(std::vector<std::string> &image_files,
    * of images vector has information in the nth element of
    * atlas_image_placements::rectangles vector */
   atlas_properties atlas_p;
-  if (algorithm == "maxrects")
-    atlas_p = maxrects(images);
+  if (hint.exact && reuse_layout(*hint.cache, atlas_p))
+    std::cout << "Reusing the layout of the last run\n";
+  else if (hint.stable &&
+           warm_start(*hint.cache, options, hint.repack_below, atlas_p))
+    ;
+  else if (algorithm == "maxrects")
+    atlas_p = maxrects(images, options);
   else if (algorithm == "guillotine")
-    atlas_p = guillotine(images);
+    atlas_p = guillotine(images, options);
+  else if (algorithm == "skyline")
+    atlas_p = skyline(images, options);
+  else if (algorithm == "auto")
+    atlas_p = auto_pack(images, options);
   else {
     std::cerr << std::format("algorithm: '{}' is not valid input\n", algorithm);
     std::exit(1);
   }
 
+  if (atlas_p.pages.empty()) {
+    if (options.max_width != 0 || options.max_height != 0)
+      std::cerr << "An image is larger than the maximum page size\n";
+    else
+      std::cerr << "Images do not fit in the largest supported atlas\n";
+    std::exit(1);
+  }
+
   std::cout << "Atlas Size\n";
-  std::cout << atlas_p.width << "x" << atlas_p.height << '\n';
+  for (const atlas_page &page : atlas_p.pages)
+    std::cout << page.width << "x" << page.height << '\n';
 
   return atlas_p;
 }
 
-std::vector<std::uint8_t>
-convert_packed_to_atlas(const atlas_properties &properties) {
-  std::vector<std::uint8_t> atlas_raw_vector;
-  atlas_raw_vector.resize(properties.width * properties.height *
-                          images[0].components_per_pixel);
+/* copies a width x height block of pixels turned 90 degrees clockwise,
+ * source pixel (x, y) lands on (height - 1 - y, x). going through the
+ * image in small tiles keeps both the rows read and the columns
+ * written in cache, a straight row by row walk misses on every write */
+static void blit_rotated(std::uint8_t *destination,
+                         std::size_t destination_stride,
+                         const std::uint8_t *source, std::size_t source_stride,
+                         int width, int height, int components_per_pixel) {
+  constexpr int tile = 16;
+  for (int ty = 0; ty < height; ty += tile) {
+    for (int tx = 0; tx < width; tx += tile) {
+      const int y_end = std::min(ty + tile, height);
+      const int x_end = std::min(tx + tile, width);
+      for (int y = ty; y < y_end; y++) {
+        const std::uint8_t *row =
+            source + std::size_t(y) * source_stride * components_per_pixel;
+        std::uint8_t *column =
+            destination + std::size_t(height - 1 - y) * components_per_pixel;
+        for (int x = tx; x < x_end; x++)
+          std::memcpy(column + std::size_t(x) * destination_stride *
+                                   components_per_pixel,
+                      row + std::size_t(x) * components_per_pixel,
+                      components_per_pixel);
+      }
+    }
+  }
+}
+
+/* fills the padding pixels around rect with copies of its outermost
+ * pixels: the left and right columns first, then the top and bottom
+ * rows including the corners that the columns just filled */
+static void extrude_edges(std::uint8_t *page, std::size_t page_width,
+                          const rectangle &rect, int padding,
+                          int components_per_pixel) {
+  auto pixel = [&](int x, int y) {
+    return page + (std::size_t(y) * page_width + x) * components_per_pixel;
+  };
+  for (int y = rect.y; y < rect.y + rect.height; y++) {
+    for (int p = 1; p <= padding; p++) {
+      std::memcpy(pixel(rect.x - p, y), pixel(rect.x, y),
+                  components_per_pixel);
+      std::memcpy(pixel(rect.x + rect.width - 1 + p, y),
+                  pixel(rect.x + rect.width - 1, y), components_per_pixel);
+    }
+  }
+  const std::size_t row_bytes =
+      std::size_t(rect.width + 2 * padding) * components_per_pixel;
+  for (int p = 1; p <= padding; p++) {
+    std::memcpy(pixel(rect.x - padding, rect.y - p),
+                pixel(rect.x - padding, rect.y), row_bytes);
+    std::memcpy(pixel(rect.x - padding, rect.y + rect.height - 1 + p),
+                pixel(rect.x - padding, rect.y + rect.height - 1), row_bytes);
+  }
+}
+
+/* every sprite and its padding cover a part of the page no other sprite
+ * touches, so the sprites are copied in parallel. offsets are computed
+ * in std::size_t, an int overflows once a page passes 2 GiB */
+std::vector<std::vector<std::uint8_t>>
+convert_packed_to_atlas(const atlas_properties &properties, int padding,
+                        unsigned int jobs) {
+  std::vector<std::vector<std::uint8_t>> atlas_raw_vectors;
+  for (const atlas_page &page : properties.pages)
+    atlas_raw_vectors.emplace_back(std::size_t(page.width) * page.height *
+                                   images[0].components_per_pixel);
 
   int prev_comps_per_pixel = images[0].components_per_pixel;
 
   for (int i = 0; i < images.size(); i++) {
-    //..
-    if (properties.rectangles[i].width != images[i].width ||
-        properties.rectangles[i].height != images[i].height) {
+    const rectangle &rect = properties.rectangles[i];
+    const int packed_width = rect.rotated ? images[i].height : images[i].width;
+    const int packed_height = rect.rotated ? images[i].width : images[i].height;
+    if (rect.width != packed_width || rect.height != packed_height) {
       std::cerr << "Image and Rectangle sort mismatch, cannot recover...\n";
       std::cerr << "Index: " << i << '\n';
       exit(1);
@@ -187,37 +638,149 @@ convert_packed_to_atlas(const atlas_properties &properties) {
       std::cerr << "Image pixel component size mismatch\nIndex: \n" << i;
       exit(1);
     }
+  }
 
-    std::uint8_t *index_region =
-        atlas_raw_vector.data() +
-        (properties.rectangles[i].y * properties.width +
-         properties.rectangles[i].x) *
-            images[i].components_per_pixel;
+  /* --low-memory images have no pixels yet, they are decoded here and
+   * freed as soon as they are in place. a file that changed size since
+   * it was probed is reported once every worker is done */
+  std::vector<char> failed(images.size(), false);
+  parallel_for(images.size(), jobs, [&](std::size_t i) {
+    const rectangle &rect = properties.rectangles[i];
+    const int comps = images[i].components_per_pixel;
+    const std::uint8_t *pixels = images[i].data;
+    if (pixels == nullptr) {
+      int width, height, file_comps;
+      pixels = stbi_load(images[i].fullpath.string().c_str(), &width, &height,
+                         &file_comps, STBIR_RGBA);
+      if (pixels == nullptr || width != images[i].source_width ||
+          height != images[i].source_height) {
+        stbi_image_free(const_cast<std::uint8_t *>(pixels));
+        failed[i] = true;
+        return;
+      }
+    }
+    const std::size_t page_width = properties.pages[rect.page].width;
+    const std::size_t source_width = images[i].source_width;
+    std::uint8_t *index_region = atlas_raw_vectors[rect.page].data() +
+                                 (rect.y * page_width + rect.x) * comps;
+    // trimmed images start inside, and keep the stride of, the decoded pixels
+    const std::uint8_t *source_region =
+        pixels +
+        (images[i].offset_y * source_width + images[i].offset_x) * comps;
+
+    if (rect.rotated) {
+      blit_rotated(index_region, page_width, source_region, source_width,
+                   images[i].width, images[i].height, comps);
+    } else {
+      for (int row = 0; row < rect.height; row++)
+        std::memcpy(index_region + row * page_width * comps,
+                    source_region + row * source_width * comps,
+                    std::size_t(rect.width) * comps);
+    }
 
-    for (int row = 0; row < properties.rectangles[i].height; row++) {
-      std::memcpy(index_region +
-                      (row * properties.width * images[i].components_per_pixel),
-                  images[i].data +
-                      (row * images[i].width * images[i].components_per_pixel),
-                  properties.rectangles[i].width *
-                      images[i].components_per_pixel);
+    // the padding is part of the sprite's own area
+    if (padding > 0)
+      extrude_edges(atlas_raw_vectors[rect.page].data(), page_width, rect,
+                    padding, comps);
+    if (pixels != images[i].data)
+      stbi_image_free(const_cast<std::uint8_t *>(pixels));
+  });
+
+  for (int i = 0; i < images.size(); i++) {
+    if (failed[i]) {
+      std::cerr << std::format("{}(): image '{}' could not be loaded again "
+                               "or changed size\n",
+                               __func__, images[i].fullpath.string());
+      std::exit(1);
     }
   }
 
-  return atlas_raw_vector;
+  return atlas_raw_vectors;
 }
 
-void generate_structures(header_writer &header) {
-  const std::string atlas_structure_string{std::format(
-      "inline constexpr struct atlas_info{{unsigned int width,height,"
-      "components_per_pixel;}}"
-      "atlas_info={{.width={},.height={},"
-      ".components_per_pixel={}}};",
-      atlas.width, atlas.height, atlas.components_per_pixel)};
-  const std::string sprite_structure_string{
-      "struct sprite_info{unsigned int x,y,width,height;};"};
+/* with mipmaps every page also records how many levels follow each
+ * other in its bytes and at which offset each of them starts */
+void generate_structures(header_writer &header, bool trim, bool rotate,
+                         bool paged, bool mipmaps) {
+  auto mipmap_count = [&](int page) {
+    return mipmaps ? std::format(",.mipmaps={}", atlas_mip_offsets[page].size())
+                   : "";
+  };
+  const char *mipmap_member = mipmaps ? ",mipmaps" : "";
+
+  std::string atlas_structure_string;
+  if (paged) {
+    std::string page_infos;
+    for (int i = 0; i < atlas_pages.size(); i++)
+      page_infos.append(std::format("atlas_info{{.width={},.height={},"
+                                    ".components_per_pixel={}{}}},",
+                                    atlas_pages[i].width, atlas_pages[i].height,
+                                    atlas_pages[i].components_per_pixel,
+                                    mipmap_count(i)));
+    atlas_structure_string = std::format(
+        "struct atlas_info{{unsigned int width,height,"
+        "components_per_pixel{};}};"
+        "inline constexpr std::array<atlas_info,{}>atlas_page_info={{{{{}}}}};",
+        mipmap_member, atlas_pages.size(), page_infos);
+  } else {
+    const image<unsigned int> &atlas = atlas_pages.front();
+    atlas_structure_string = std::format(
+        "inline constexpr struct atlas_info{{unsigned int width,height,"
+        "components_per_pixel{};}}"
+        "atlas_info={{.width={},.height={},"
+        ".components_per_pixel={}{}}};",
+        mipmap_member, atlas.width, atlas.height, atlas.components_per_pixel,
+        mipmap_count(0));
+  }
+
+  /* pages with fewer levels than the deepest one repeat their size in
+   * the remaining offsets */
+  if (mipmaps) {
+    std::size_t deepest = 0;
+    for (const std::vector<std::size_t> &offsets : atlas_mip_offsets)
+      deepest = std::max(deepest, offsets.size());
+    std::string page_offsets;
+    for (int i = 0; i < atlas_mip_offsets.size(); i++) {
+      std::string offsets;
+      for (std::size_t level = 0; level < deepest; level++)
+        offsets.append(std::format(
+            "{},", level < atlas_mip_offsets[i].size()
+                       ? atlas_mip_offsets[i][level]
+                       : atlas_data[i].size()));
+      page_offsets.append(paged ? std::format("{{{}}},", offsets) : offsets);
+    }
+    atlas_structure_string.append(
+        paged ? std::format("inline constexpr std::array<std::array<"
+                            "std::size_t,{}>,{}>atlas_page_mip_offsets={{{{{}}}}};",
+                            deepest, atlas_mip_offsets.size(), page_offsets)
+              : std::format("inline constexpr std::array<std::size_t,{}>"
+                            "atlas_mip_offsets={{{}}};",
+                            deepest, page_offsets));
+  }
+
+  /* trimmed sprites also carry where the packed part sits inside
+   * the original image and how big that image was */
+  /* width and height are always those of the packed region, a rotated
+   * sprite is stored turned 90 degrees clockwise */
+  const std::string sprite_structure_string{std::format(
+      "struct sprite_info{{unsigned int x,y,width,height{}{}{};}};",
+      trim ? ",offset_x,offset_y,source_width,source_height" : "",
+      paged ? ",page" : "", rotate ? ";bool rotated" : "")};
   const std::string uv_structure_string{
-      "struct uv_coords{float u0,v0,u1,v1;};"};
+      rotate ? "struct uv_coords{float u0,v0,u1,v1;bool rotated;};"
+             : "struct uv_coords{float u0,v0,u1,v1;};"};
+
+  /* block compressed pages hold 4x4 pixel blocks, components_per_pixel
+   * is that of the pixels they decode to */
+  for (const auto &[name, format] : block_format_names) {
+    if (format != atlas_format || format == block_format::rgba8)
+      continue;
+    atlas_structure_string.append(std::format(
+        "enum class texture_format{{rgba8,bc1,bc3,bc7}};"
+        "inline constexpr texture_format atlas_format=texture_format::{};"
+        "inline constexpr std::size_t atlas_block_bytes={};",
+        name, block_bytes(format)));
+  }
 
   header.write(atlas_structure_string);
   header.write(sprite_structure_string);
@@ -239,17 +802,87 @@ void generate_sprite_filename_array(header_writer &header) {
   header.write(sprite_indiced_filename_string);
 }
 
-void generate_raylib_function_defs(header_writer &header) {
+/* compressed atlases are unpacked into memory from MemAlloc(), such an
+ * Image owns its pixels and has to be released with UnloadImage() */
+void generate_compressed_raylib_function_defs(header_writer &header,
+                                              bool paged, bool mipmaps,
+                                              std::string_view pixel_format) {
+  // clang-format off
+  const std::string raylib_atlas_image_function_string {paged ? std::format(
+    "inline Image raylib_atlas_image(unsigned int page){{"
+      "const atlas_info&info=atlas_page_info[page];"
+      "Image image{{MemAlloc(atlas_page_sizes[page]),"
+      "static_cast<int>(info.width),static_cast<int>(info.height),"
+      "{},{}}};"
+      "decompress_atlas_page(page,static_cast<std::uint8_t*>(image.data));"
+      "return image;"
+    "}}", mipmaps ? "static_cast<int>(info.mipmaps)" : "1", pixel_format) : std::format(
+    "inline Image raylib_atlas_image(){{"
+      "Image image{{MemAlloc(atlas_size),atlas_info.width,atlas_info.height,"
+      "{},{}}};"
+      "decompress_atlas(static_cast<std::uint8_t*>(image.data));"
+      "return image;"
+    "}}", mipmaps ? "static_cast<int>(atlas_info.mipmaps)" : "1", pixel_format)
+  };
+
+  const std::string raylib_atlas_texture_function_string {std::format(
+    "inline Texture2D raylib_atlas_texture({0}){{"
+      "Image image=raylib_atlas_image({1});"
+      "Texture2D texture=LoadTextureFromImage(image);"
+      "UnloadImage(image);"
+      "return texture;"
+    "}}", paged ? "unsigned int page" : "", paged ? "page" : "")
+  };
+  // clang-format on
+
+  header.write(raylib_atlas_image_function_string);
+  header.write(raylib_atlas_texture_function_string);
+}
+
+/* raylib has no BPTC format, bc7 is refused before the header is written */
+std::string_view raylib_pixel_format() {
+  switch (atlas_format) {
+  case block_format::bc1:
+    return "PIXELFORMAT_COMPRESSED_DXT1_RGBA";
+  case block_format::bc3:
+    return "PIXELFORMAT_COMPRESSED_DXT5_RGBA";
+  default:
+    return "PIXELFORMAT_UNCOMPRESSED_R8G8B8A8";
+  }
+}
+
+void generate_raylib_function_defs(header_writer &header, bool paged,
+                                   bool mipmaps) {
+  if (header.compressing()) {
+    generate_compressed_raylib_function_defs(header, paged, mipmaps,
+                                             raylib_pixel_format());
+    return;
+  }
+
   // clang-format off
-  const std::string raylib_atlas_image_function_string {std::format(
+  const std::string raylib_atlas_image_function_string {paged ? std::format(
+    "inline Image raylib_atlas_image(unsigned int page){{"
+      "return Image{{reinterpret_cast<void*>(const_cast<{}*>(atlas_page_data[page])),"
+      "static_cast<int>(atlas_page_info[page].width),"
+      "static_cast<int>(atlas_page_info[page].height),"
+      "{},{}}};"
+    "}}", header.byte_type(),
+    mipmaps ? "static_cast<int>(atlas_page_info[page].mipmaps)" : "1",
+    raylib_pixel_format()) : std::format(
     "inline Image raylib_atlas_image(){{"
       "return Image{{reinterpret_cast<void*>(const_cast<{}*>(atlas.data())),"
       "atlas_info.width,atlas_info.height,"
-      "1,PIXELFORMAT_UNCOMPRESSED_R8G8B8A8}};"
-    "}}", header.byte_type())
+      "{},{}}};"
+    "}}", header.byte_type(),
+    mipmaps ? "static_cast<int>(atlas_info.mipmaps)" : "1",
+    raylib_pixel_format())
   };
 
-  const std::string raylib_atlas_texture_function_string {
+  /* pages are loaded one at a time so a scene only uploads what it uses */
+  const std::string raylib_atlas_texture_function_string {paged ?
+    "inline Texture2D raylib_atlas_texture(unsigned int page){"
+      "return LoadTextureFromImage(raylib_atlas_image(page));"
+    "}" :
     "inline Texture2D raylib_atlas_texture(){"
       "return LoadTextureFromImage(raylib_atlas_image());"
     "}"
@@ -260,52 +893,104 @@ void generate_raylib_function_defs(header_writer &header) {
   header.write(raylib_atlas_texture_function_string);
 }
 
-void generate_utility_functions(header_writer &header, bool debug) {
+/* a constexpr int function(const char*) giving the value of a name or -1,
+ * through a minimal perfect hash: a hash picks the bucket, a second one
+ * with the bucket's seed the slot, and a single compare confirms it. the
+ * first of repeated names wins, as it did in the linear search */
+void generate_name_lookup(header_writer &header, std::string_view prefix,
+                          std::string_view function,
+                          const std::vector<std::string> &names,
+                          const std::vector<int> &values) {
+  std::vector<std::string> unique_names;
+  std::vector<int> unique_values;
+  std::unordered_set<std::string_view> seen;
+  for (int i = 0; i < names.size(); i++) {
+    if (seen.insert(names[i]).second) {
+      unique_names.push_back(names[i]);
+      unique_values.push_back(values[i]);
+    }
+  }
+
+  const perfect_hash hash = build_perfect_hash(unique_names);
+  std::string seeds{}, slot_names{}, slot_values{};
+  for (int i = 0; i < unique_names.size(); i++) {
+    seeds.append(std::format("{},", hash.seeds[i]));
+    slot_names.append(std::format("\"{}\",", unique_names[hash.slots[i]]));
+    slot_values.append(std::format("{},", unique_values[hash.slots[i]]));
+  }
+
+  // clang-format off
+  /* Format: first: prefix, second: name count, third: function name,
+   * fourth: seeds, fifth: names, sixth: values, seventh: hash lambda */
+  header.write(std::format(
+      "inline constexpr std::array<std::int32_t,{1}> {0}_lookup_seeds={{{3}}};"
+      "inline constexpr std::array<const char*,{1}> {0}_lookup_names={{{4}}};"
+      "inline constexpr std::array<int,{1}> {0}_lookup_values={{{5}}};"
+      "inline constexpr int {2}(const char* string){{"
+        "{6}"
+        "const std::int32_t seed={0}_lookup_seeds[silly_hash(string,0)%{1}];"
+        "const std::uint32_t slot=seed<0?std::uint32_t(-(seed+1))"
+                                  ":silly_hash(string,std::uint32_t(seed))%{1};"
+        "const char* tmp={0}_lookup_names[slot];"
+        "while(*string!='\\0'&&*string==*tmp)++string,++tmp;"
+        "return *string==*tmp?{0}_lookup_values[slot]:-1;"
+      "}}", prefix, unique_names.size(), function, seeds, slot_names,
+      slot_values, name_hash_source()));
+  // clang-format on
+}
+
+void generate_utility_functions(header_writer &header, bool debug,
+                                bool rotate, bool paged) {
 
   /* unsure whether we need to (x,y)+0.5 or not to get something called
    * the 'texel', need input from K ig? also probably see the repeated
    * file-name situation and how to handle that since I will be generating
    * an enum from those names to access into sprite_info[N] */
   // clang-format off
-  const std::string sprite_coord_normalize_function_string{
-      "inline constexpr uv_coords normalized(const sprite_info sprite){"
-      "return{sprite.x/float(atlas_info.width),sprite.y/float(atlas_info.height),"
-      "(sprite.x+sprite.width)/float(atlas_info.width),"
-      "(sprite.y+sprite.height)/float(atlas_info.height)}; }"};
-
-  if(debug){
-  /* Format: first: filename string literal count */
-  const std::string index_by_str_function_string{std::format(
-      "inline constexpr int get_sprite_index(const char* string){{"
-        "const auto& silly_strlen=[](const char* str)constexpr{{"
-          "unsigned int count = 0;"
-          "while (*str!='\\0')++count,++str;"
-          "return count;"
-          "}};"
-        "for(unsigned int i=0;i<{0};i++){{"
-          "if(silly_strlen(string)!=silly_strlen(sprite_filenames[i]))continue;"
-          "const char* tmp=sprite_filenames[i];"
-          "while(*string!='\\0'&&*string==*tmp)++string,++tmp;"
-          "if(static_cast<unsigned char>(*string)-static_cast<unsigned char>(*tmp)==0)return i;"
-        "}}"
-        "return -1;"
-      "}}", images.size())};
-
-    // clang-format on
-    header.write(index_by_str_function_string);
+  const std::string sprite_coord_normalize_function_string{std::format(
+      "inline constexpr uv_coords normalized(const sprite_info sprite){{"
+      "return{{sprite.x/float({0}.width),sprite.y/float({0}.height),"
+      "(sprite.x+sprite.width)/float({0}.width),"
+      "(sprite.y+sprite.height)/float({0}.height){1}}}; }}",
+      paged ? "atlas_page_info[sprite.page]" : "atlas_info",
+      rotate ? ",sprite.rotated" : "")};
+
+  // clang-format on
+  if (debug) {
+    /* aliases resolve to the index of the sprite whose pixels they share */
+    std::vector<std::string> names;
+    std::vector<int> values;
+    for (int i = 0; i < images.size(); i++) {
+      names.push_back(images[i].filename.string());
+      values.push_back(i);
+    }
+    const std::vector<int> alias_indices = resolve_alias_indices();
+    for (int i = 0; i < image_aliases.size(); i++) {
+      names.push_back(image_aliases[i].filename.string());
+      values.push_back(alias_indices[i]);
+    }
+    generate_name_lookup(header, "sprite", "get_sprite_index", names, values);
   }
   header.write(sprite_coord_normalize_function_string);
 }
 
 void generate_variables(header_writer &header,
-                        const atlas_properties &packed_data) {
+                        const atlas_properties &packed_data, bool trim,
+                        bool rotate, bool paged) {
   const std::string sprite_structure_array_string{std::format(
       "inline constexpr std::array<sprite_info,{}>sprites={{", images.size())};
   std::string sprite_filled_string{""};
-  for (const rectangle &rect : packed_data.rectangles) {
-    sprite_filled_string.append(std::format("sprite_info{{{},{},{},{}}},",
-                                            rect.x, rect.y, rect.width,
-                                            rect.height));
+  for (int i = 0; i < packed_data.rectangles.size(); i++) {
+    const rectangle &rect = packed_data.rectangles[i];
+    std::string trim_fields{""};
+    if (trim)
+      trim_fields = std::format(",{},{},{},{}", images[i].offset_x,
+                                images[i].offset_y, images[i].source_width,
+                                images[i].source_height);
+    sprite_filled_string.append(std::format(
+        "sprite_info{{{},{},{},{}{}{}{}}},", rect.x, rect.y, rect.width,
+        rect.height, trim_fields, paged ? std::format(",{}", rect.page) : "",
+        rotate ? (rect.rotated ? ",true" : ",false") : ""));
   }
   sprite_filled_string.append("};");
 
@@ -314,6 +999,11 @@ void generate_variables(header_writer &header,
     sprite_enum_string.append(
         std::format("{} = {},", images[i].clean_filename, i));
   }
+  std::vector<int> alias_indices = resolve_alias_indices();
+  for (int i = 0; i < image_aliases.size(); i++) {
+    sprite_enum_string.append(std::format(
+        "{} = {},", image_aliases[i].clean_filename, alias_indices[i]));
+  }
   sprite_enum_string.append(
       std::format("min_index=0,max_index={},", images.size() - 1));
   sprite_enum_string.append("};");
@@ -339,42 +1029,42 @@ void generate_extra_filename_array(
   header.write(extras_filename_string);
 }
 
-void generate_extra_utility_functions(header_writer &header,
-                                      const std::size_t filenames_count) {
-  // clang-format off
-  /* Format: first: filename string literal count */
-  const std::string index_by_str_function_string{std::format(
-      "inline constexpr int get_extra_symbol_index(const char* string){{"
-        "const auto& silly_strlen=[](const char* str)constexpr{{"
-          "unsigned int count = 0;"
-          "while (*str!='\\0')++count,++str;"
-          "return count;"
-          "}};"
-        "for(unsigned int i=0;i<{0};i++){{"
-          "if(silly_strlen(string)!=silly_strlen(extra_filenames[i]))continue;"
-          "const char* tmp=extra_filenames[i];"
-          "while(*string!='\\0'&&*string==*tmp)++string,++tmp;"
-          "if(static_cast<unsigned char>(*string)-static_cast<unsigned char>(*tmp)==0)return i;"
-        "}}"
-        "return -1;"
-      "}}", filenames_count)};
-      header.write(index_by_str_function_string);
-  // clang-format on
+void generate_extra_utility_functions(
+    header_writer &header, const std::vector<std::filesystem::path> &extra) {
+  std::vector<std::string> names;
+  std::vector<int> values;
+  for (int i = 0; i < extra.size(); i++) {
+    names.push_back(extra[i].filename().string());
+    values.push_back(i);
+  }
+  generate_name_lookup(header, "extra", "get_extra_symbol_index", names,
+                       values);
 }
 
 void generate_extra_symbol_pointer_array(header_writer &header,
                                          std::vector<std::string> &filenames) {
 
+  /* compressed data and size are those of the LZ4 block, it unpacks
+   * into decompressed_size bytes with the header's decompress function */
   const std::string extra_symbol_info_structure_string{
-      "struct extra_symbol_info{const void* data; std::size_t size;};"};
+      header.compressing()
+          ? "struct extra_symbol_info{const void* data; std::size_t size; "
+            "std::size_t decompressed_size;};"
+          : "struct extra_symbol_info{const void* data; std::size_t size;};"};
   header.write(extra_symbol_info_structure_string);
 
   std::string comma_separated_filename_literal_string{};
   for (const std::string &file : filenames) {
     comma_separated_filename_literal_string.append(
-        std::format("extra_symbol_info{{static_cast<const void*>({0}.data()),"
-                    "{0}.size()}},",
-                    file));
+        header.compressing()
+            ? std::format("extra_symbol_info{{static_cast<const void*>("
+                          "{0}_compressed.data()),{0}_compressed.size(),"
+                          "{0}_size}},",
+                          file)
+            : std::format(
+                  "extra_symbol_info{{static_cast<const void*>({0}.data()),"
+                  "{0}.size()}},",
+                  file));
   }
 
   std::string extras_filename_string{
@@ -389,13 +1079,12 @@ void generate_extra_lookup_info(
     header_writer &header, std::vector<std::string> &filenames,
     std::vector<std::filesystem::path> actual_filenames) {
   generate_extra_filename_array(header, actual_filenames);
-  generate_extra_utility_functions(header, filenames.size());
+  generate_extra_utility_functions(header, actual_filenames);
   generate_extra_symbol_pointer_array(header, filenames);
 }
 
 void generate_extra_files_arrays(header_writer &header,
                                  std::vector<std::string> &extras, bool debug) {
-  std::vector<std::uint8_t> data;
   std::vector<std::filesystem::path> packed_files;
   std::vector<std::string> sanitized_filenames;
 
@@ -413,49 +1102,74 @@ void generate_extra_files_arrays(header_writer &header,
     }
     packed_files.push_back(std::filesystem::path(filename).filename());
 
-    std::ifstream input(filename);
+    /* mapped rather than read, the encoder streams it out in chunks
+     * so even huge files never need a copy in memory */
+    mapped_file input(filename);
     if (!input.is_open()) {
       std::cerr << std::format("{}: failed to open: reason: {}\n", filename,
-                               std::strerror(errno));
+                               std::strerror(input.error()));
       std::exit(1);
     }
-    input.seekg(0, std::ios::end);
-    std::size_t size = input.tellg();
-    input.seekg(0, std::ios::beg);
-    input.clear();
-
-    data.resize(size);
-    input.read(reinterpret_cast<char *>(data.data()), size);
 
     std::string sanitized;
     get_sanitized_name(sanitized,
                        std::filesystem::path(filename).filename().string(),
                        header.using_namespace());
-    header.write_byte_array(sanitized, data.data(), data.size());
+    header.write_byte_array(sanitized, input.data(), input.size());
     sanitized_filenames.push_back(sanitized);
-
-    input.close();
-    data.clear();
   }
 
   if (debug)
     generate_extra_lookup_info(header, sanitized_filenames, packed_files);
 }
 
+void generate_atlas_page_arrays(header_writer &header) {
+  std::string page_pointers{}, page_sizes{};
+  for (int i = 0; i < atlas_data.size(); i++) {
+    const std::string name = std::format("atlas_page_{}", i);
+    header.write_byte_array(name, atlas_data[i].data(), atlas_data[i].size(),
+                            true);
+    page_pointers.append(std::format(
+        header.compressing() ? "decompress_{}," : "{}.data(),", name));
+    page_sizes.append(std::format("{}_size,", name));
+  }
+
+  // a page picked at runtime goes through a table of the per-page accessors
+  if (header.compressing()) {
+    header.write(std::format(
+        "inline constexpr std::array<std::size_t,{0}> atlas_page_sizes={{{2}}};"
+        "inline void decompress_atlas_page(unsigned int page,"
+        "std::uint8_t*destination){{"
+        "constexpr std::array<void(*)(std::uint8_t*),{0}> pages={{{1}}};"
+        "pages[page](destination);}}",
+        atlas_data.size(), page_pointers, page_sizes));
+    return;
+  }
+  header.write(std::format("inline constexpr std::array<const {}*,{}> "
+                           "atlas_page_data={{{}}};",
+                           header.byte_type(), atlas_data.size(),
+                           page_pointers));
+}
+
 void generate_atlas_header(header_writer &header, const packer_args &args,
                            const atlas_properties &packed_data) {
   if (not args.image_files.empty()) {
-    generate_structures(header);
+    const bool paged = not args.max_size.empty();
+    generate_structures(header, args.trim, args.allow_rotate, paged,
+                        args.mipmaps);
     if (args.debug) {
       generate_sprite_filename_array(header);
     }
-    generate_utility_functions(header, args.debug);
-    generate_variables(header, packed_data);
-
-    // main atlas array
-    header.write_byte_array(
-        "atlas", atlas.data,
-        atlas.height * atlas.width * atlas.components_per_pixel, true);
+    generate_utility_functions(header, args.debug, args.allow_rotate, paged);
+    generate_variables(header, packed_data, args.trim, args.allow_rotate,
+                       paged);
+
+    // main atlas array, or one per page
+    if (paged)
+      generate_atlas_page_arrays(header);
+    else
+      header.write_byte_array("atlas", atlas_data.front().data(),
+                              atlas_data.front().size(), true);
   }
 
   if (not args.extra_files.empty()) {
@@ -464,12 +1178,177 @@ void generate_atlas_header(header_writer &header, const packer_args &args,
 
   if (not args.image_files.empty()) {
     if (header.using_raylib())
-      generate_raylib_function_defs(header);
+      generate_raylib_function_defs(header, not args.max_size.empty(),
+                                    args.mipmaps);
   }
   std::cout << "Output Header: " << args.output_header << '\n';
+  if (not header.get_data_path().empty())
+    std::cout << "Output Data: " << header.get_data_path().string() << '\n';
+}
+
+/* appends the mip chain to the pixels of every page and block compresses
+ * every level, atlas_mip_offsets records where each level starts. block
+ * compressed chains stop above 4 pixels, a smaller level would still take
+ * a whole block and not every loader sizes those right */
+void build_atlas_levels(bool mipmaps, unsigned int jobs) {
+  const std::uint32_t min_side =
+      atlas_format == block_format::rgba8 ? 1 : block_side;
+  for (int i = 0; i < atlas_pages.size(); i++) {
+    image<unsigned int> &page = atlas_pages[i];
+    const int levels =
+        mipmaps ? mip_level_count(page.width, page.height, min_side) : 1;
+    std::vector<std::vector<std::uint8_t>> chain =
+        generate_mipmaps(atlas_data[i].data(), page.width, page.height,
+                         page.components_per_pixel, levels, jobs);
+    chain.insert(chain.begin(), std::move(atlas_data[i]));
+
+    std::vector<std::size_t> offsets;
+    std::size_t size = 0;
+    for (int level = 0; level < levels; level++) {
+      if (atlas_format != block_format::rgba8)
+        chain[level] = encode_blocks(
+            chain[level].data(), mip_side(page.width, level),
+            mip_side(page.height, level), page.components_per_pixel,
+            atlas_format, jobs);
+      offsets.push_back(size);
+      size += chain[level].size();
+    }
+
+    if (levels == 1) {
+      atlas_data[i] = std::move(chain.front());
+    } else {
+      atlas_data[i].clear();
+      atlas_data[i].reserve(size);
+      for (const std::vector<std::uint8_t> &level : chain)
+        atlas_data[i].insert(atlas_data[i].end(), level.begin(), level.end());
+    }
+    page.data = atlas_data[i].data();
+    atlas_mip_offsets.push_back(std::move(offsets));
+  }
+}
+
+/* the sprites of --format as little endian 32 bit words: "SPAK", version,
+ * page, sprite and alias counts and the texture format in the order of
+ * --texture. then every page as width, height, mip levels and file name,
+ * every sprite as x, y, width, height, page, rotated, offset x and y,
+ * source width and height and name, every alias as name and sprite index.
+ * names are byte offsets into the nul terminated strings ending the file */
+void write_sprite_file(const std::filesystem::path &path,
+                       const std::vector<std::string> &page_files,
+                       const atlas_properties &packed_data) {
+  std::vector<std::uint8_t> words, strings;
+  auto put = [&words](std::uint32_t value) {
+    for (int i = 0; i < 4; i++)
+      words.push_back(std::uint8_t(value >> (8 * i)));
+  };
+  auto put_name = [&put, &strings](const std::string &name) {
+    put(strings.size());
+    strings.insert(strings.end(), name.begin(), name.end());
+    strings.push_back(0);
+  };
+
+  words = {'S', 'P', 'A', 'K'};
+  put(1);
+  put(atlas_pages.size());
+  put(images.size());
+  put(image_aliases.size());
+  put(std::uint32_t(atlas_format));
+  for (int i = 0; i < atlas_pages.size(); i++) {
+    put(atlas_pages[i].width);
+    put(atlas_pages[i].height);
+    put(atlas_mip_offsets[i].size());
+    put_name(page_files[i]);
+  }
+  for (int i = 0; i < images.size(); i++) {
+    const rectangle &rect = packed_data.rectangles[i];
+    for (int value : {rect.x, rect.y, rect.width, rect.height, rect.page,
+                      int(rect.rotated), images[i].offset_x,
+                      images[i].offset_y, images[i].source_width,
+                      images[i].source_height})
+      put(value);
+    put_name(images[i].filename.string());
+  }
+  std::vector<int> alias_indices = resolve_alias_indices();
+  for (int i = 0; i < image_aliases.size(); i++) {
+    put_name(image_aliases[i].filename.string());
+    put(alias_indices[i]);
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(words.data()), words.size());
+  file.write(reinterpret_cast<const char *>(strings.data()), strings.size());
+  file.close();
+  if (file.fail()) {
+    std::cerr << std::format("Could not write {}\n", path.string());
+    std::exit(1);
+  }
+}
+
+/* every page with its mip levels as it is in atlas_data, named like the
+ * pngs, and the sprite file next to them */
+void write_texture_files(const std::string &stem, bool paged,
+                         texture_container container,
+                         const atlas_properties &packed_data) {
+  const std::string_view extension =
+      std::find_if(texture_container_names.begin(),
+                   texture_container_names.end(),
+                   [container](const auto &name) {
+                     return name.second == container;
+                   })
+          ->first;
+  std::vector<std::string> page_files;
+  for (int i = 0; i < atlas_pages.size(); i++) {
+    const image<unsigned int> &atlas = atlas_pages[i];
+    std::string filename = paged ? std::format("{}_{}.{}", stem, i, extension)
+                                 : std::format("{}.{}", stem, extension);
+    if (not write_texture_file(filename, container, atlas_format, atlas.width,
+                               atlas.height, atlas_data[i],
+                               atlas_mip_offsets[i])) {
+      std::cerr << std::format("Could not write {}\n", filename);
+      std::exit(1);
+    }
+    std::cout << std::format("Output {}: {}\n", extension, filename);
+    atlas_image_files.push_back(filename);
+    page_files.push_back(std::move(filename));
+  }
+
+  const std::string sprite_file = std::format("{}.sprites", stem);
+  write_sprite_file(sprite_file, page_files, packed_data);
+  std::cout << "Output sprites: " << sprite_file << '\n';
+  atlas_image_files.push_back(sprite_file);
+}
+
+/* WxH, either side may be 0 to leave it unbounded but not both */
+void parse_max_size(const std::string &size, packer_options &options) {
+  unsigned int width = 0, height = 0;
+  char separator = 0, trailing = 0;
+  if (std::sscanf(size.c_str(), "%u%c%u%c", &width, &separator, &height,
+                  &trailing) != 3 ||
+      (separator != 'x' && separator != 'X') || (width == 0 && height == 0)) {
+    std::cerr << std::format("max-size: '{}' is not valid input, expected "
+                             "WxH\n",
+                             size);
+    std::exit(1);
+  }
+  options.max_width = width;
+  options.max_height = height;
 }
 
-atlas_properties operate_on_args(packer_args &args) {
+/* looks name up in one of the name tables of packer.h */
+template <typename Enum, std::size_t N>
+Enum parse_option(
+    const std::array<std::pair<std::string_view, Enum>, N> &names,
+    const std::string &name, const std::string_view &what) {
+  for (const auto &[option_name, value] : names) {
+    if (option_name == name)
+      return value;
+  }
+  std::cerr << std::format("{}: '{}' is not valid input\n", what, name);
+  std::exit(1);
+}
+
+atlas_properties operate_on_args(packer_args &args,
+                                 const layout_hint &hint) {
   std::string filename = args.output_header;
   if (filename.empty()) {
     std::cerr << "Empty output header filename not allowed\n";
@@ -482,31 +1361,129 @@ atlas_properties operate_on_args(packer_args &args) {
                    args.algorithm.begin(),
                    [](unsigned char c) { return std::tolower(c); });
 
+    if (args.size_step < 0) {
+      std::cerr << "Size step must not be negative\n";
+      std::exit(1);
+    }
+    packer_options options{.jobs = resolve_jobs(args.jobs),
+                           .size_step = std::uint32_t(args.size_step),
+                           .allow_rotate = args.allow_rotate};
+    if (not args.max_size.empty())
+      parse_max_size(args.max_size, options);
+    atlas_format = parse_option(block_format_names, args.texture, "texture");
+    if (atlas_format != block_format::rgba8) {
+      if (args.size_step % block_side != 0) {
+        std::cerr << std::format("Size step must be a multiple of {} for "
+                                 "block compressed textures\n",
+                                 block_side);
+        std::exit(1);
+      }
+      if (atlas_format == block_format::bc7 && args.raylib_utils) {
+        std::cerr << "texture: raylib has no pixel format for bc7\n";
+        std::exit(1);
+      }
+      options.alignment = block_side;
+    }
+    if (args.padding < 0) {
+      std::cerr << "Padding must not be negative\n";
+      std::exit(1);
+    }
+    options.padding = args.padding;
+    if (args.png_level < 0 || args.png_level > 9) {
+      std::cerr << "Png level must be between 0 and 9\n";
+      std::exit(1);
+    }
+    texture_container container = texture_container::ktx2;
+    if (not args.format.empty()) {
+      container = parse_option(texture_container_names, args.format, "format");
+      if (container == texture_container::qoi &&
+          atlas_format != block_format::rgba8) {
+        std::cerr << "format: qoi only holds rgba8 pixels\n";
+        std::exit(1);
+      }
+    }
+    if (args.repack_below < 0 || args.repack_below > 100) {
+      std::cerr << "Repack threshold must be a percentage\n";
+      std::exit(1);
+    }
+    if (not args.heuristic.empty())
+      options.heuristic =
+          parse_option(fit_heuristic_names, args.heuristic, "heuristic");
+    if (not args.sort.empty())
+      options.sort = parse_option(sort_order_names, args.sort, "sort");
+    /* skyline has no free rectangles to choose from and auto tries every
+     * heuristic and order itself, asking for one of them would be lost */
+    if ((args.algorithm == "guillotine" &&
+         (options.heuristic == fit_heuristic::bottom_left ||
+          options.heuristic == fit_heuristic::contact_point)) ||
+        (not args.heuristic.empty() &&
+         (args.algorithm == "skyline" || args.algorithm == "auto"))) {
+      std::cerr << std::format("heuristic: '{}' is not supported by {}\n",
+                               args.heuristic, args.algorithm);
+      std::exit(1);
+    }
+    if (not args.sort.empty() && args.algorithm == "auto") {
+      std::cerr << std::format("sort: '{}' is not supported by auto\n",
+                               args.sort);
+      std::exit(1);
+    }
+
     atlas_properties packed_data =
         pack_images_to_rectangles(args.image_files, args.algorithm,
-                                  args.duplicates, not args.spacename.empty());
-
-    atlas_data = convert_packed_to_atlas(packed_data);
-
-    atlas = {.width = packed_data.width,
-             .height = packed_data.height,
-             .components_per_pixel =
-                 static_cast<unsigned int>(images[0].components_per_pixel),
-             .data = atlas_data.data()};
+                                  args.duplicates, not args.spacename.empty(),
+                                  args.trim, args.low_memory, options, hint);
+
+    atlas_data =
+        convert_packed_to_atlas(packed_data, args.padding, options.jobs);
+
+    for (int i = 0; i < packed_data.pages.size(); i++) {
+      image<unsigned int> page{};
+      page.width = packed_data.pages[i].width;
+      page.height = packed_data.pages[i].height;
+      page.components_per_pixel =
+          static_cast<unsigned int>(images[0].components_per_pixel);
+      page.data = atlas_data[i].data();
+      atlas_pages.push_back(page);
+    }
 
+    const std::string stem =
+        std::filesystem::path(args.output_header).stem().string();
     if (args.generate_png) {
-      std::string filename = std::format(
-          "{}.png", std::filesystem::path(args.output_header).stem().c_str());
-      stbi_write_png(filename.c_str(), atlas.width, atlas.height,
-                     atlas.components_per_pixel, atlas_data.data(),
-                     atlas.width * atlas.components_per_pixel);
-      std::cout << "Output png: " << filename << '\n';
+      for (int i = 0; i < atlas_pages.size(); i++) {
+        const image<unsigned int> &atlas = atlas_pages[i];
+        std::string filename = args.max_size.empty()
+                                   ? std::format("{}.png", stem)
+                                   : std::format("{}_{}.png", stem, i);
+        bool written;
+        if (args.png_level <= max_strip_png_level) {
+          written = write_png(filename, atlas.data, atlas.width, atlas.height,
+                              atlas.components_per_pixel, args.png_level,
+                              options.jobs);
+        } else {
+          stbi_write_png_compression_level = args.png_level;
+          written = stbi_write_png(filename.c_str(), atlas.width, atlas.height,
+                                   atlas.components_per_pixel, atlas.data,
+                                   atlas.width * atlas.components_per_pixel);
+        }
+        if (not written) {
+          std::cerr << std::format("Could not write {}\n", filename);
+          std::exit(1);
+        }
+        std::cout << "Output png: " << filename << '\n';
+        atlas_image_files.push_back(filename);
+      }
     }
 
+    // the png keeps the pixels, only the header gets the levels and blocks
+    build_atlas_levels(args.mipmaps, options.jobs);
+    if (not args.format.empty())
+      write_texture_files(stem, not args.max_size.empty(), container,
+                          packed_data);
+
     packed_data.filename = args.output_header;
     return packed_data;
   }
-  return {.filename = filename};
+  return {.pages = {}, .rectangles = {}, .filename = filename};
 }
 
 std::string get_guard_string(const std::string &filename,
@@ -518,6 +1495,105 @@ std::string get_guard_string(const std::string &filename,
   return std::format("SILLY_PACKER_GENERATED_{}_H", sanitized);
 }
 
+/* the options that decide where images go, an empty heuristic is baf */
+std::string layout_options(const packer_args &args) {
+  return std::format("{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n",
+                     args.algorithm, args.size_step,
+                     args.heuristic.empty() ? "baf" : args.heuristic, args.trim,
+                     args.allow_rotate, args.max_size, args.texture,
+                     args.padding, args.sort);
+}
+
+std::uint64_t layout_hash(const packer_args &args) {
+  const std::string options = layout_options(args);
+  return content_hash(options.data(), options.size());
+}
+
+/* hash of every option that shapes the output. --jobs only changes how
+ * fast it is produced and is left out, new options have to be added */
+std::uint64_t options_hash(const packer_args &args) {
+  std::string options;
+  auto add = [&options](const auto &value) {
+    options += std::format("{}\n", value);
+  };
+  for (const std::string &file : args.image_files)
+    add(file);
+  add("extras");
+  for (const std::string &file : args.extra_files)
+    add(file);
+  add(args.output_header);
+  add(args.spacename);
+  add(args.raylib_utils);
+  add(args.generate_png);
+  add(args.png_level);
+  add(args.format);
+  add(args.duplicates);
+  add(args.debug);
+  add(args.payload);
+  add(args.split);
+  add(args.compress);
+  add(args.mipmaps);
+  add(args.low_memory);
+  add(args.stable);
+  add(args.repack_below);
+  options += layout_options(args);
+  return content_hash(options.data(), options.size());
+}
+
+/* images then extras, hashing only what changed since the last run */
+std::vector<file_fingerprint> fingerprint_inputs(const packer_args &args,
+                                                 const build_cache &previous) {
+  std::unordered_map<std::string, const file_fingerprint *> known;
+  for (const file_fingerprint &input : previous.inputs)
+    known[input.path] = &input;
+
+  std::vector<std::string> files = args.image_files;
+  files.insert(files.end(), args.extra_files.begin(), args.extra_files.end());
+  std::vector<file_fingerprint> inputs(files.size());
+  parallel_for(files.size(), resolve_jobs(args.jobs), [&](std::size_t i) {
+    auto found = known.find(files[i]);
+    inputs[i] = fingerprint_file(
+        files[i], found == known.end() ? nullptr : found->second, true);
+  });
+  return inputs;
+}
+
+/* nothing to do when the options and inputs match the last run and its
+ * outputs have not been touched since */
+bool is_up_to_date(const build_cache &previous, const build_cache &current) {
+  if (previous.options_hash != current.options_hash ||
+      previous.inputs != current.inputs || previous.outputs.empty())
+    return false;
+  for (const file_fingerprint &output : previous.outputs) {
+    if (fingerprint_file(output.path, nullptr, false) != output)
+      return false;
+  }
+  return true;
+}
+
+void write_cache(header_writer &header, const atlas_properties &packed_data,
+                 build_cache &cache) {
+  header.close();
+  cache.pages = packed_data.pages;
+  for (int i = 0; i < images.size(); i++) {
+    const image<int> &img = images[i];
+    cache.sprites.push_back({.path = img.fullpath.string(),
+                             .rect = packed_data.rectangles[i],
+                             .width = img.width,
+                             .height = img.height,
+                             .offset_x = img.offset_x,
+                             .offset_y = img.offset_y,
+                             .source_width = img.source_width,
+                             .source_height = img.source_height});
+  }
+  std::vector<std::filesystem::path> outputs = header.written_files();
+  outputs.insert(outputs.end(), atlas_image_files.begin(),
+                 atlas_image_files.end());
+  for (const std::filesystem::path &output : outputs)
+    cache.outputs.push_back(fingerprint_file(output.string(), nullptr, false));
+  write_build_cache(build_cache_path(packed_data.filename), cache);
+}
+
 int main(int argc, char *argv[]) {
   if (argc == 1) {
     std::cerr << std::format("{}: must take in some image parameters\n",
@@ -533,13 +1609,41 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  atlas_properties packed_data = operate_on_args(args);
+  const payload_mode payload =
+      parse_option(payload_mode_names, args.payload, "payload");
+
+  build_cache previous, current;
+  layout_hint hint;
+  if (args.stable)
+    args.cache = true;
+  if (args.cache) {
+    const bool cached =
+        read_build_cache(build_cache_path(args.output_header), previous);
+    current.options_hash = options_hash(args);
+    current.layout_hash = layout_hash(args);
+    current.inputs = fingerprint_inputs(args, previous);
+    if (cached && is_up_to_date(previous, current)) {
+      std::cout << "Up to date: " << args.output_header << '\n';
+      return 0;
+    }
+    if (cached)
+      hint = {.cache = &previous,
+              .exact = previous.options_hash == current.options_hash,
+              .stable = args.stable &&
+                        previous.layout_hash == current.layout_hash,
+              .repack_below = args.repack_below};
+  }
+
+  atlas_properties packed_data = operate_on_args(args, hint);
 
   std::string guard =
       get_guard_string(packed_data.filename, not args.spacename.empty());
   header_writer header(packed_data.filename, "SILLY_PACKER_GENERATED_ATLAS_H",
-                       args.spacename, args.raylib_utils);
+                       args.spacename, args.raylib_utils, payload, args.split,
+                       args.compress);
 
   generate_atlas_header(header, args, packed_data);
+  if (args.cache)
+    write_cache(header, packed_data, current);
   cleanup_stb_images();
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "mapped_file.h"
+#include <cerrno>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+mapped_file::mapped_file(const std::filesystem::path &path) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    _error = GetLastError() == ERROR_FILE_NOT_FOUND ? ENOENT : EACCES;
+    return;
+  }
+
+  LARGE_INTEGER size;
+  if (not GetFileSizeEx(file, &size)) {
+    _error = EIO;
+    CloseHandle(file);
+    return;
+  }
+  _size = static_cast<std::size_t>(size.QuadPart);
+  // empty files can not be mapped, they have nothing to read anyway
+  if (_size != 0) {
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+      _data = static_cast<const std::uint8_t *>(
+          MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      CloseHandle(mapping);
+    }
+    if (_data == nullptr) {
+      _error = ENOMEM;
+      CloseHandle(file);
+      return;
+    }
+  }
+  CloseHandle(file);
+  _is_open = true;
+}
+
+mapped_file::~mapped_file() {
+  if (_data != nullptr)
+    UnmapViewOfFile(_data);
+}
+#else
+mapped_file::mapped_file(const std::filesystem::path &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    _error = errno;
+    return;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) == -1) {
+    _error = errno;
+    close(fd);
+    return;
+  }
+  if (not S_ISREG(status.st_mode)) {
+    _error = EISDIR;
+    close(fd);
+    return;
+  }
+  _size = static_cast<std::size_t>(status.st_size);
+  // empty files can not be mapped, they have nothing to read anyway
+  if (_size != 0) {
+    void *mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      _error = errno;
+      close(fd);
+      return;
+    }
+    // read front to back exactly once, lets the kernel read ahead
+    madvise(mapping, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const std::uint8_t *>(mapping);
+  }
+  close(fd);
+  _is_open = true;
+}
+
+mapped_file::~mapped_file() {
+  if (_data != nullptr)
+    munmap(const_cast<std::uint8_t *>(_data), _size);
+}
+#endif
+
+bool mapped_file::is_open() const { return _is_open; }
+
+int mapped_file::error() const { return _error; }
+
+const std::uint8_t *mapped_file::data() const { return _data; }
+
+std::size_t mapped_file::size() const { return _size; }
@@ -0,0 +1,46 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_MAPPED_FILE_H
+#define SILLY_PACKER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+/* read-only view of a whole file through the page cache, nothing is
+ * copied and pages that have been read can be dropped again by the OS,
+ * so huge files cost address space rather than memory */
+class mapped_file {
+public:
+  explicit mapped_file(const std::filesystem::path &path);
+  ~mapped_file();
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  bool is_open() const;
+  /* errno style reason when is_open() is false */
+  int error() const;
+  const std::uint8_t *data() const;
+  std::size_t size() const;
+
+private:
+  const std::uint8_t *_data = nullptr;
+  std::size_t _size = 0;
+  bool _is_open = false;
+  int _error = 0;
+};
+
+#endif
@@ -18,92 +18,132 @@
 #include <algorithm>
 #include <cstdint>
 
-using rectangle_vector = std::vector<rectangle>;
 using std::uint32_t;
 
-struct baf_score {
-  int index = invalid;
-  uint32_t area_fit = 0;
-  uint32_t short_side_fit = 0;
-  uint32_t long_side_fit = 0;
+/* lower is better, compared field by field */
+struct fit_score {
+  std::int64_t primary = 0;
+  std::int64_t secondary = 0;
+  std::int64_t tertiary = 0;
 };
 
 /* we can guarantee these casts because we'll establish a
  * predicate that this code always takes in positive ints
  * and no funky negative width, height images will be there */
-static rectangle img2rect(image<int> image) {
+static rectangle img2rect(const image<int> &image) {
   return {0, 0, image.width, image.height};
 }
 
 static uint32_t area(const rectangle &rect) { return rect.width * rect.height; }
 
-static uint32_t select_best(std::vector<baf_score> &scores,
-                            const rectangle_vector &selections) {
-  // sort by area
-  std::sort(scores.begin(), scores.end(),
-            [](const baf_score &s1, const baf_score &s2) {
-              return s1.area_fit < s2.area_fit;
-            });
-
-  std::vector<baf_score> tie;
-  uint32_t smallest = scores[0].area_fit;
-  for (const baf_score &s : scores) {
-    if (s.area_fit == smallest)
-      tie.push_back(s);
-    else
-      break;
-  }
+/* length of the shared part of two segments, 0 if they don't touch */
+static int common_interval(int start1, int end1, int start2, int end2) {
+  if (end1 < start2 || end2 < start1)
+    return 0;
+  return std::min(end1, end2) - std::max(start1, start2);
+}
 
-  if (tie.size() == 0)
-    return scores[0].index;
+/* how much of the candidate's border touches the atlas edges or
+ * already placed rectangles */
+static int contact_score(const rectangle &candidate, int atlas_width,
+                         int atlas_height, const rectangle_vector &placed) {
+  int score = 0;
+  if (candidate.x == 0 || candidate.x + candidate.width == atlas_width)
+    score += candidate.height;
+  if (candidate.y == 0 || candidate.y + candidate.height == atlas_height)
+    score += candidate.width;
 
-  std::sort(tie.begin(), tie.end(),
-            [](const baf_score &s1, const baf_score &s2) {
-              if (s1.short_side_fit != s2.short_side_fit)
-                return s1.short_side_fit < s2.short_side_fit;
-              return s1.long_side_fit < s2.long_side_fit;
-            });
-  return tie[0].index;
+  for (const rectangle &other : placed) {
+    if (other.x == candidate.x + candidate.width ||
+        other.x + other.width == candidate.x)
+      score += common_interval(other.y, other.y + other.height, candidate.y,
+                               candidate.y + candidate.height);
+    if (other.y == candidate.y + candidate.height ||
+        other.y + other.height == candidate.y)
+      score += common_interval(other.x, other.x + other.width, candidate.x,
+                               candidate.x + candidate.width);
+  }
+  return score;
 }
 
-static rectangle calculate_best_area_fit(const rectangle &to_fit,
-                                         const rectangle_vector &selections) {
-  std::vector<baf_score> scores(selections.size());
-  scores.resize(selections.size());
-  for (int i = 0; i < selections.size(); i++) {
-    scores[i].index = i;
-    scores[i].area_fit = area(selections[i]) - area(to_fit);
-    scores[i].short_side_fit = std::min(selections[i].width - to_fit.width,
-                                        selections[i].height - to_fit.height);
-    scores[i].long_side_fit = std::max(selections[i].width - to_fit.width,
-                                       selections[i].height - to_fit.height);
+static fit_score calculate_fit(const rectangle &to_fit, const rectangle &free,
+                               fit_heuristic heuristic, int atlas_width,
+                               int atlas_height,
+                               const rectangle_vector &placed) {
+  const std::int64_t short_side = std::min(free.width - to_fit.width,
+                                           free.height - to_fit.height);
+  const std::int64_t long_side = std::max(free.width - to_fit.width,
+                                          free.height - to_fit.height);
+  switch (heuristic) {
+  case fit_heuristic::best_area_fit:
+    return {area(free) - area(to_fit), short_side, long_side};
+  case fit_heuristic::best_short_side_fit:
+    return {short_side, long_side};
+  case fit_heuristic::best_long_side_fit:
+    return {long_side, short_side};
+  case fit_heuristic::bottom_left:
+    return {free.y + to_fit.height, free.x};
+  case fit_heuristic::contact_point:
+    return {-contact_score({free.x, free.y, to_fit.width, to_fit.height},
+                           atlas_width, atlas_height, placed)};
   }
-  uint32_t index = select_best(scores, selections);
-  return selections[index];
+  return {};
 }
 
+static bool is_better_fit(const fit_score &s1, const fit_score &s2) {
+  if (s1.primary != s2.primary)
+    return s1.primary < s2.primary;
+  if (s1.secondary != s2.secondary)
+    return s1.secondary < s2.secondary;
+  return s1.tertiary < s2.tertiary;
+}
+
+/* single pass over the free rectangles, when every score ties the first
+ * free rectangle in the list wins and the unturned image before the
+ * turned one. returns where to_fit should be placed */
 static rectangle find_selection(const rectangle &to_fit,
-                                const rectangle_vector &free) {
-  rectangle_vector selections;
+                                const rectangle_vector &free,
+                                fit_heuristic heuristic, bool allow_rotate,
+                                int atlas_width, int atlas_height,
+                                const rectangle_vector &placed) {
+  rectangle best = make_invalid_rectangle();
+  fit_score best_score;
+  const rectangle rotated = rotate(to_fit);
+  const int orientations =
+      (allow_rotate && to_fit.width != to_fit.height) ? 2 : 1;
+
   for (int i = 0; i < free.size(); i++) {
-    if (canfit(to_fit, free[i])) {
-      selections.push_back(free[i]);
-    } // if can fit
-  } // for free_recs
+    for (int turn = 0; turn < orientations; turn++) {
+      const rectangle &candidate = turn ? rotated : to_fit;
+      if (not canfit(candidate, free[i]))
+        continue;
 
-  if (selections.size() == 0)
-    return make_invalid_rectangle();
+      fit_score score = calculate_fit(candidate, free[i], heuristic,
+                                      atlas_width, atlas_height, placed);
+      if (is_invalid_rectangle(best) || is_better_fit(score, best_score)) {
+        best = {free[i].x, free[i].y, candidate.width, candidate.height,
+                candidate.rotated};
+        best_score = score;
+      }
+    }
+  } // for free_recs
 
-  return calculate_best_area_fit(to_fit, selections);
+  return best;
 }
 
+/* split_indices receives the positions in free_recs of every rectangle
+ * that was produced by splitting, prune_free_overlapping() needs them */
 static void handle_overlaps_and_splits(rectangle_vector &free_recs,
-                                       const rectangle placed) {
+                                       const rectangle placed,
+                                       std::vector<int> &split_indices) {
   rectangle_vector new_free;
+  split_indices.clear();
 
   auto push_if_valid = [&](rectangle r) {
-    if (r.width > 0 && r.height > 0)
+    if (r.width > 0 && r.height > 0) {
+      split_indices.push_back(new_free.size());
       new_free.push_back(r);
+    }
   };
 
   for (const rectangle &free : free_recs) {
@@ -131,68 +171,197 @@ static void handle_overlaps_and_splits(rectangle_vector &free_recs,
   free_recs.swap(new_free);
 }
 
-static void prune_free_overlapping(rectangle_vector &free_rects) {
-  std::vector<bool> to_prune(free_rects.size(), false);
-  for (int i = 0; i < free_rects.size(); i++) {
+/* removes every free rectangle that is contained by another one.
+ * the rectangles that survived the previous prune can not contain
+ * each other, so only pairs where at least one side is a fresh split
+ * have to be compared: O(F * splits) instead of O(F^2) per placement.
+ * identical rectangles contain each other and are both removed, just
+ * like the exhaustive all-pairs check did */
+static void prune_free_overlapping(rectangle_vector &free_rects,
+                                   const std::vector<int> &split_indices,
+                                   std::vector<bool> &to_prune) {
+  to_prune.assign(free_rects.size(), false);
+  for (int i : split_indices) {
     for (int j = 0; j < free_rects.size(); j++) {
-      if (i != j && containable(free_rects[i], free_rects[j]))
+      if (i == j)
+        continue;
+      if (containable(free_rects[i], free_rects[j]))
         to_prune[i] = true;
+      if (containable(free_rects[j], free_rects[i]))
+        to_prune[j] = true;
     }
   }
 
-  rectangle_vector cleaned;
+  // compact in place, keeping the order selection ties depend on
+  int kept = 0;
   for (int i = 0; i < free_rects.size(); i++) {
     if (to_prune[i])
       continue;
-    cleaned.push_back(free_rects[i]);
+    free_rects[kept++] = free_rects[i];
   }
-
-  free_rects.swap(cleaned);
+  free_rects.resize(kept);
 }
 
 static rectangle_vector
-maxrect_baf_pack_rectangles(int atlas_width, int atlas_height,
-                            std::vector<image<int>> rectangles) {
+maxrect_pack_rectangles(int atlas_width, int atlas_height,
+                        const std::vector<image<int>> &rectangles,
+                        fit_heuristic heuristic, bool allow_rotate,
+                        bool partial) {
   rectangle_vector free_recs = {{0, 0, atlas_width, atlas_height}};
   rectangle_vector placed;
+  std::vector<int> split_indices;
+  std::vector<bool> to_prune;
 
-  for (image<int> &to_fit : rectangles) {
+  for (const image<int> &to_fit : rectangles) {
 
-    rectangle selection = find_selection(img2rect(to_fit), free_recs);
-    if (is_invalid_rectangle(selection))
-      return rectangle_vector{make_invalid_rectangle()};
-    placed.push_back({selection.x, selection.y, to_fit.width, to_fit.height});
+    rectangle selection =
+        find_selection(img2rect(to_fit), free_recs, heuristic, allow_rotate,
+                       atlas_width, atlas_height, placed);
+    if (is_invalid_rectangle(selection)) {
+      if (not partial)
+        return rectangle_vector{make_invalid_rectangle()};
+      placed.push_back(selection);
+      continue;
+    }
+    placed.push_back(selection);
 
-    handle_overlaps_and_splits(
-        free_recs,
-        rectangle{selection.x, selection.y, to_fit.width, to_fit.height});
-    prune_free_overlapping(free_recs);
+    handle_overlaps_and_splits(free_recs, selection, split_indices);
+    prune_free_overlapping(free_recs, split_indices, to_prune);
   } // for to_fit input rectangles
 
   return placed;
 }
 
-atlas_properties maxrects(std::vector<image<int>> &images) {
+atlas_properties maxrects(std::vector<image<int>> &images,
+                          const packer_options &options) {
   /* we sort by area, in our guillotine impl it's max side up */
-  std::sort(images.begin(), images.end(),
-            [](const image<int> &img1, const image<int> &img2) {
-              return (img1.width * img1.height) > (img2.width * img2.height);
-            });
-
-  uint32_t atlas_width = closest_power_of_two(calculate_min_side(images)),
-           atlas_height = closest_power_of_two(calculate_min_side(images));
-  while (true) {
-    rectangle_vector placed_rectangles =
-        maxrect_baf_pack_rectangles(atlas_width, atlas_height, images);
-    if (is_invalid_rectangle(*placed_rectangles.begin())) {
-      if (atlas_width <= atlas_height)
-        atlas_width *= 2;
-      else
-        atlas_height *= 2;
+  sort_images(images, options.sort.value_or(sort_order::area));
+
+  return search_atlas_size(
+      images,
+      [&options](int width, int height,
+                 const std::vector<image<int>> &rectangles, bool partial) {
+        return maxrect_pack_rectangles(width, height, rectangles,
+                                       options.heuristic, options.allow_rotate,
+                                       partial);
+      },
+      options);
+}
+
+atlas_properties maxrects_warm_start(const std::vector<image<int>> &images,
+                                     const atlas_properties &previous,
+                                     const packer_options &options) {
+  const int padding = options.padding;
+  const int alignment = std::max(options.alignment, 1u);
+  // the same growth as the padded images of search_atlas_size()
+  auto padded = [&](int side) {
+    return (side + 2 * padding + alignment - 1) / alignment * alignment;
+  };
+
+  atlas_properties atlas = previous;
+  std::vector<rectangle_vector> free_recs, placed(atlas.pages.size());
+  for (const atlas_page &page : atlas.pages)
+    free_recs.push_back({{0, 0, int(page.width), int(page.height)}});
+  std::vector<int> split_indices;
+  std::vector<bool> to_prune;
+  auto occupy = [&](const rectangle &footprint, int page) {
+    handle_overlaps_and_splits(free_recs[page], footprint, split_indices);
+    prune_free_overlapping(free_recs[page], split_indices, to_prune);
+    placed[page].push_back(footprint);
+  };
+
+  /* the last page grows by one allowed step of its shorter side, nothing
+   * placed so far moves. false once both sides are at their maximum */
+  const uint32_t max_width =
+      options.max_width ? std::min(options.max_width, max_atlas_side)
+                        : max_atlas_side;
+  const uint32_t max_height =
+      options.max_height ? std::min(options.max_height, max_atlas_side)
+                         : max_atlas_side;
+  auto next_side = [&options](uint32_t side) {
+    return options.size_step == 0 ? side * 2 : side + options.size_step;
+  };
+  auto grow_last_page = [&]() {
+    atlas_page &page = atlas.pages.back();
+    const bool can_widen = next_side(page.width) <= max_width;
+    const bool can_heighten = next_side(page.height) <= max_height;
+    if (can_widen && (page.width <= page.height || not can_heighten))
+      page.width = next_side(page.width);
+    else if (can_heighten)
+      page.height = next_side(page.height);
+    else
+      return false;
 
+    rectangle_vector footprints;
+    footprints.swap(placed.back());
+    free_recs.back() = {{0, 0, int(page.width), int(page.height)}};
+    for (const rectangle &footprint : footprints)
+      occupy(footprint, atlas.pages.size() - 1);
+    return true;
+  };
+
+  /* with a maximum page size an image that finds no room even on a full
+   * grown page starts a new one, as small as the size policy allows */
+  const bool paged = options.max_width != 0 || options.max_height != 0;
+  auto add_page = [&](const rectangle &to_fit) {
+    auto allowed_side = [&options](uint32_t side) {
+      return options.size_step == 0
+                 ? closest_power_of_two(side)
+                 : (side + options.size_step - 1) / options.size_step *
+                       options.size_step;
+    };
+    const atlas_page page = {allowed_side(to_fit.width),
+                             allowed_side(to_fit.height)};
+    if (not paged || page.width > max_width || page.height > max_height)
+      return false;
+    atlas.pages.push_back(page);
+    free_recs.push_back({{0, 0, int(page.width), int(page.height)}});
+    placed.emplace_back();
+    return true;
+  };
+
+  std::vector<int> waiting;
+  for (int i = 0; i < images.size(); i++) {
+    const rectangle &rect = previous.rectangles[i];
+    if (is_invalid_rectangle(rect)) {
+      waiting.push_back(i);
       continue;
     }
+    occupy({rect.x - padding, rect.y - padding, padded(rect.width),
+            padded(rect.height)},
+           rect.page);
+  }
+
+  std::stable_sort(waiting.begin(), waiting.end(), [&images](int i, int j) {
+    return images[i].width * images[i].height >
+           images[j].width * images[j].height;
+  });
+  for (int i : waiting) {
+    const rectangle to_fit = {0, 0, padded(images[i].width),
+                              padded(images[i].height)};
+    int page = 0;
+    rectangle selection = make_invalid_rectangle();
+    while (true) {
+      for (page = 0; page < atlas.pages.size(); page++) {
+        selection = find_selection(to_fit, free_recs[page], options.heuristic,
+                                   options.allow_rotate,
+                                   atlas.pages[page].width,
+                                   atlas.pages[page].height, placed[page]);
+        if (not is_invalid_rectangle(selection))
+          break;
+      }
+      if (not is_invalid_rectangle(selection))
+        break;
+      if (not grow_last_page() && not add_page(to_fit))
+        return {};
+    }
+    occupy(selection, page);
 
-    return {atlas_width, atlas_height, placed_rectangles};
+    rectangle &rect = atlas.rectangles[i];
+    rect = {selection.x + padding, selection.y + padding,
+            selection.rotated ? images[i].height : images[i].width,
+            selection.rotated ? images[i].width : images[i].height,
+            selection.rotated, page};
   }
-}
\ No newline at end of file
+  return atlas;
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Mip chain of the atlas pages. Each level is a box filtered half of the
+ * one before it, so a level k texel covers exactly the 2^k x 2^k pixels
+ * under it, which is what makes --padding predictable: a sprite whose
+ * border holds 2^k - 1 copies of its edge pixels does not pick up its
+ * neighbours down to level k. stb_image_resize2 spreads one level over
+ * several threads through its split API, the levels themselves have to
+ * be made in order.
+ */
+#include "mipmap.h"
+#include "parallel.h"
+#include <stb_image_resize2.h>
+
+int mip_level_count(std::uint32_t width, std::uint32_t height,
+                    std::uint32_t min_side) {
+  int levels = 1;
+  while (mip_side(width, levels - 1) > 1 || mip_side(height, levels - 1) > 1) {
+    if (std::min(mip_side(width, levels), mip_side(height, levels)) <
+        min_side)
+      break;
+    levels++;
+  }
+  return levels;
+}
+
+static stbir_pixel_layout pixel_layout(int components_per_pixel) {
+  switch (components_per_pixel) {
+  case 1:
+    return STBIR_1CHANNEL;
+  case 2:
+    return STBIR_RA;
+  case 3:
+    return STBIR_RGB;
+  default:
+    return STBIR_RGBA;
+  }
+}
+
+std::vector<std::vector<std::uint8_t>>
+generate_mipmaps(const std::uint8_t *pixels, std::uint32_t width,
+                 std::uint32_t height, int components_per_pixel, int levels,
+                 unsigned int jobs) {
+  std::vector<std::vector<std::uint8_t>> mipmaps;
+  mipmaps.reserve(std::max(levels - 1, 0));
+  const std::uint8_t *previous = pixels;
+  for (int level = 1; level < levels; level++) {
+    const std::uint32_t level_width = mip_side(width, level);
+    const std::uint32_t level_height = mip_side(height, level);
+    std::vector<std::uint8_t> &mipmap = mipmaps.emplace_back(
+        std::size_t(level_width) * level_height * components_per_pixel);
+
+    STBIR_RESIZE resize;
+    stbir_resize_init(&resize, previous, mip_side(width, level - 1),
+                      mip_side(height, level - 1), 0, mipmap.data(),
+                      level_width, level_height, 0,
+                      pixel_layout(components_per_pixel),
+                      STBIR_TYPE_UINT8_SRGB);
+    stbir_set_filters(&resize, STBIR_FILTER_BOX, STBIR_FILTER_BOX);
+    const int splits = stbir_build_samplers_with_splits(&resize, jobs);
+    parallel_for(splits, jobs, [&](std::size_t split) {
+      stbir_resize_extended_split(&resize, split, 1);
+    });
+    stbir_free_samplers(&resize);
+    previous = mipmap.data();
+  }
+  return mipmaps;
+}
@@ -0,0 +1,41 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_MIPMAP_H
+#define SILLY_PACKER_MIPMAP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/* side of mip level level, halved per level and never below 1 */
+inline std::uint32_t mip_side(std::uint32_t side, int level) {
+  return std::max<std::uint32_t>(side >> level, 1);
+}
+
+/* levels of a width x height image including itself. the chain stops
+ * once the smaller side would drop below min_side, 1 goes down to 1x1 */
+int mip_level_count(std::uint32_t width, std::uint32_t height,
+                    std::uint32_t min_side = 1);
+
+/* levels 1 to levels - 1 of the mip chain, each one resized from the one
+ * before it with a box filter (sRGB aware and alpha weighted for RGBA).
+ * every level is split into bands of rows over up to jobs threads */
+std::vector<std::vector<std::uint8_t>>
+generate_mipmaps(const std::uint8_t *pixels, std::uint32_t width,
+                 std::uint32_t height, int components_per_pixel, int levels,
+                 unsigned int jobs);
+
+#endif
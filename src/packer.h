@@ -16,14 +16,24 @@
 #ifndef SILLY_SURVIVORS_PACKER_H
 #define SILLY_SURVIVORS_PACKER_H
 
+#include <array>
 #include <concepts>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 struct rectangle {
   int x, y, width, height;
+  /* placed turned 90 degrees clockwise, width and height are then
+   * those of the turned image */
+  bool rotated = false;
+  /* atlas page the rectangle was placed on */
+  int page = 0;
 };
 
 template <std::integral IntType> struct image {
@@ -33,16 +43,119 @@ template <std::integral IntType> struct image {
   std::filesystem::path filename; // for duplication check
   std::filesystem::path
       fullpath; // actual input as path, unsued: future proofing in-case needed
+  /* width and height are the part of the pixels that gets packed, which
+   * starts at offset_x, offset_y and is smaller than the decoded
+   * source_width x source_height when the image has been trimmed */
+  IntType offset_x = 0, offset_y = 0;
+  IntType source_width = 0, source_height = 0;
 };
 
-struct atlas_properties {
+using rectangle_vector = std::vector<rectangle>;
+
+struct atlas_page {
   std::uint32_t width;
   std::uint32_t height;
+};
+
+/* no pages means the images did not fit */
+struct atlas_properties {
+  std::vector<atlas_page> pages;
   std::vector<rectangle> rectangles;
   std::filesystem::path filename;
 };
 
-atlas_properties maxrects(std::vector<image<int>> &images);
-atlas_properties guillotine(std::vector<image<int>> &images);
+/* how a packer picks the free rectangle for the next image,
+ * guillotine only supports the first three */
+enum class fit_heuristic {
+  best_area_fit,
+  best_short_side_fit,
+  best_long_side_fit,
+  bottom_left,
+  contact_point,
+};
+
+/* order in which images are handed to the packers, largest first */
+enum class sort_order {
+  area,
+  perimeter,
+  max_side,
+  width,
+  height,
+};
+
+/* command line spelling of the options above */
+inline constexpr std::array<std::pair<std::string_view, fit_heuristic>, 5>
+    fit_heuristic_names{{
+        {"baf", fit_heuristic::best_area_fit},
+        {"bssf", fit_heuristic::best_short_side_fit},
+        {"blsf", fit_heuristic::best_long_side_fit},
+        {"bl", fit_heuristic::bottom_left},
+        {"cp", fit_heuristic::contact_point},
+    }};
+
+inline constexpr std::array<std::pair<std::string_view, sort_order>, 5>
+    sort_order_names{{
+        {"area", sort_order::area},
+        {"perimeter", sort_order::perimeter},
+        {"max-side", sort_order::max_side},
+        {"width", sort_order::width},
+        {"height", sort_order::height},
+    }};
+
+/* sides beyond this overflow the int area math of the packers */
+inline constexpr std::uint32_t max_atlas_side = 1u << 15;
+
+struct packer_options {
+  unsigned int jobs = 1;
+  /* atlas sides are multiples of this, 0 keeps them powers of two */
+  std::uint32_t size_step = 0;
+  fit_heuristic heuristic = fit_heuristic::best_area_fit;
+  /* empty means the packer's own preferred order */
+  std::optional<sort_order> sort = std::nullopt;
+  bool allow_rotate = false;
+  /* largest page, images that do not fit on one page spill onto more.
+   * 0 leaves that side unbounded, 0x0 always packs a single page */
+  std::uint32_t max_width = 0;
+  std::uint32_t max_height = 0;
+  /* empty pixels kept free on every side of an image */
+  std::uint32_t padding = 0;
+  /* image sides (with their padding) are packed as if rounded up to
+   * multiples of this, which puts every padded image at a position
+   * that is a multiple of it as well */
+  std::uint32_t alignment = 1;
+};
+
+/* places the images, in order, into a width x height atlas and returns one
+ * rectangle per image, or a single invalid rectangle as soon as one of them
+ * does not fit. with partial set the images that do not fit get an invalid
+ * rectangle each and the rest are still placed */
+using pack_function =
+    std::function<rectangle_vector(int width, int height,
+                                   const std::vector<image<int>> &images,
+                                   bool partial)>;
+
+/* finds the smallest atlas (by area) that pack can fill and, if max_width
+ * or max_height are set, spills onto as many pages as needed.
+ * see size_search.cpp */
+atlas_properties search_atlas_size(const std::vector<image<int>> &images,
+                                   const pack_function &pack,
+                                   const packer_options &options);
+
+atlas_properties maxrects(std::vector<image<int>> &images,
+                          const packer_options &options);
+atlas_properties guillotine(std::vector<image<int>> &images,
+                            const packer_options &options);
+atlas_properties skyline(std::vector<image<int>> &images,
+                         const packer_options &options);
+/* keeps every image that has a valid rectangle in previous (lined up
+ * with images) where it is and fits the others, largest first, into the
+ * space left on the pages of previous. the last page grows as far as
+ * max_width x max_height allow, no pages means they still did not fit */
+atlas_properties maxrects_warm_start(const std::vector<image<int>> &images,
+                                     const atlas_properties &previous,
+                                     const packer_options &options);
+/* packs with every maxrects heuristic and sort order, keeps the smallest */
+atlas_properties auto_pack(std::vector<image<int>> &images,
+                           const packer_options &options);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_PARALLEL_H
+#define SILLY_PACKER_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/* a jobs value of 0 (or less) means use every available hardware thread */
+inline unsigned int resolve_jobs(int jobs) {
+  if (jobs > 0)
+    return static_cast<unsigned int>(jobs);
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/* calls fn(i) for every i in [0, count) on up to `jobs` threads.
+ * indices are handed out one at a time through an atomic counter
+ * so that uneven work (large and small images) balances itself.
+ * fn must not call std::exit(), collect errors and report them
+ * from the calling thread instead */
+template <typename Function>
+void parallel_for(std::size_t count, unsigned int jobs, Function &&fn) {
+  const std::size_t workers = std::min<std::size_t>(jobs, count);
+  if (workers <= 1) {
+    for (std::size_t i = 0; i < count; i++)
+      fn(i);
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  std::vector<std::thread> threads;
+  threads.reserve(workers);
+  for (std::size_t t = 0; t < workers; t++) {
+    threads.emplace_back([&]() {
+      for (std::size_t i = next.fetch_add(1); i < count;
+           i = next.fetch_add(1))
+        fn(i);
+    });
+  }
+
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+#endif
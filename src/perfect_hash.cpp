@@ -0,0 +1,102 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/*
+ * Builds the perfect hash behind the generated name lookups with hash,
+ * displace and compress (Belazzougui, Botelho, Dietzfelbinger 2009) minus
+ * the compression: the largest buckets pick a seed first, while most slots
+ * are still free, single name buckets fill the remaining slots directly.
+ */
+#include "perfect_hash.h"
+#include <algorithm>
+#include <numeric>
+
+std::uint32_t name_hash(std::string_view name, std::uint32_t seed) {
+  std::uint32_t h = 2166136261u ^ seed * 2654435769u;
+  for (const char c : name)
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  return h;
+}
+
+perfect_hash build_perfect_hash(const std::vector<std::string> &names) {
+  const std::uint32_t count = names.size();
+  std::vector<std::vector<std::uint32_t>> buckets(count);
+  for (std::uint32_t i = 0; i < count; i++)
+    buckets[name_hash(names[i], 0) % count].push_back(i);
+  std::vector<std::uint32_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&buckets](std::uint32_t a, std::uint32_t b) {
+                     return buckets[a].size() > buckets[b].size();
+                   });
+
+  perfect_hash hash{.seeds = std::vector<std::int32_t>(count, 0),
+                    .slots = std::vector<std::uint32_t>(count)};
+  std::vector<char> taken(count, false);
+  std::vector<std::uint32_t> placed;
+  std::uint32_t next_free = 0;
+  for (const std::uint32_t bucket : order) {
+    const std::vector<std::uint32_t> &members = buckets[bucket];
+    if (members.empty())
+      break;
+
+    if (members.size() == 1) {
+      while (taken[next_free])
+        next_free++;
+      taken[next_free] = true;
+      hash.slots[next_free] = members.front();
+      hash.seeds[bucket] = -std::int32_t(next_free) - 1;
+      continue;
+    }
+
+    for (std::int32_t seed = 1;; seed++) {
+      placed.clear();
+      for (const std::uint32_t name : members) {
+        const std::uint32_t slot = name_hash(names[name], seed) % count;
+        if (taken[slot] ||
+            std::find(placed.begin(), placed.end(), slot) != placed.end())
+          break;
+        placed.push_back(slot);
+      }
+      if (placed.size() != members.size())
+        continue;
+
+      for (std::size_t i = 0; i < placed.size(); i++) {
+        taken[placed[i]] = true;
+        hash.slots[placed[i]] = members[i];
+      }
+      hash.seeds[bucket] = seed;
+      break;
+    }
+  }
+  return hash;
+}
+
+const std::string &name_hash_source() {
+  // clang-format off
+  static const std::string source{
+    "const auto silly_hash=[](const char*str,std::uint32_t seed)constexpr{"
+      "std::uint32_t h=2166136261u^seed*2654435769u;"
+      "while(*str!='\\0')h=(h^static_cast<unsigned char>(*str++))*16777619u;"
+      "h^=h>>15;h*=0x2c1b3c6du;h^=h>>12;"
+      "return h;"
+    "};"
+  };
+  // clang-format on
+  return source;
+}
@@ -0,0 +1,45 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_PERFECT_HASH_H
+#define SILLY_PACKER_PERFECT_HASH_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* a minimal perfect hash over distinct names, every name gets its own slot
+ * in [0, n). name_hash() with seed 0 spreads the names over n buckets and
+ * every bucket gets a seed that sends all of its names to free slots, a
+ * bucket of a single name stores its slot as -slot - 1 instead */
+struct perfect_hash {
+  std::vector<std::int32_t> seeds;
+  /* index of the name in every slot */
+  std::vector<std::uint32_t> slots;
+};
+
+/* FNV-1a started from the seed, with a final mix so that the low bits
+ * used by the modulo depend on every byte */
+std::uint32_t name_hash(std::string_view name, std::uint32_t seed);
+
+/* names must not repeat, no seed could separate two equal ones */
+perfect_hash build_perfect_hash(const std::vector<std::string> &names);
+
+/* source of the silly_hash lambda written into lookup functions, it
+ * computes name_hash() on a nul terminated string */
+const std::string &name_hash_source();
+
+#endif
@@ -0,0 +1,455 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/*
+ * Strip parallel PNG writer. A PNG filter only looks at the raw row above,
+ * so the image is cut into strips of rows that are filtered and deflated
+ * on their own. Every strip is a single deflate block with the fixed
+ * Huffman codes that ends in an empty stored block, which byte aligns it,
+ * so the strips are concatenated into one zlib stream as they are (the way
+ * pigz does it). The LZ77 window starts empty in every strip, which costs
+ * a little ratio. Level 0 puts the rows in stored blocks instead. Specs:
+ * https://www.w3.org/TR/png/ and RFC 1950, 1951
+ */
+#include "png_writer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+/* raw bytes per strip, enough for the LZ77 window to pay off and for the
+ * chunk overhead not to matter */
+static constexpr std::size_t strip_bytes = std::size_t(1) << 20;
+static constexpr std::size_t window_size = 32768;
+static constexpr int min_match = 3;
+static constexpr int max_match = 258;
+static constexpr int hash_log = 15;
+static constexpr std::uint32_t adler_base = 65521;
+/* per level: hash chain links followed per position, and the longest
+ * match whose positions still go into the hash chains (like zlib, the
+ * long runs of transparent pixels are not worth indexing at low levels) */
+static constexpr std::array<int, max_strip_png_level + 1> max_chain = {0, 1, 8,
+                                                                       64};
+static constexpr std::array<int, max_strip_png_level + 1> max_insert = {
+    0, 4, 16, max_match};
+
+/* slicing by 8: table[k][n] is the crc of byte n followed by k zeros,
+ * so that 8 bytes are folded in with 8 independent lookups */
+static constexpr std::array<std::array<std::uint32_t, 256>, 8> crc_table = [] {
+  std::array<std::array<std::uint32_t, 256>, 8> table{};
+  for (std::uint32_t n = 0; n < 256; n++) {
+    std::uint32_t c = n;
+    for (int k = 0; k < 8; k++)
+      c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    table[0][n] = c;
+  }
+  for (int k = 1; k < 8; k++) {
+    for (std::uint32_t n = 0; n < 256; n++)
+      table[k][n] = (table[k - 1][n] >> 8) ^ table[0][table[k - 1][n] & 0xff];
+  }
+  return table;
+}();
+
+static std::uint32_t crc32(const std::uint8_t *data, std::size_t size) {
+  std::uint32_t crc = 0xffffffffu;
+  for (; size >= 8; data += 8, size -= 8) {
+    const std::uint32_t low = crc ^ (data[0] | data[1] << 8 | data[2] << 16 |
+                                     std::uint32_t(data[3]) << 24);
+    crc = crc_table[7][low & 0xff] ^ crc_table[6][(low >> 8) & 0xff] ^
+          crc_table[5][(low >> 16) & 0xff] ^ crc_table[4][low >> 24] ^
+          crc_table[3][data[4]] ^ crc_table[2][data[5]] ^
+          crc_table[1][data[6]] ^ crc_table[0][data[7]];
+  }
+  for (; size > 0; data++, size--)
+    crc = crc_table[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static std::uint32_t adler32(const std::uint8_t *data, std::size_t size) {
+  std::uint32_t a = 1, b = 0;
+  while (size > 0) {
+    // the longest run whose sums can not overflow 32 bits
+    const std::size_t run = std::min<std::size_t>(size, 5552);
+    for (std::size_t i = 0; i < run; i++) {
+      a += data[i];
+      b += a;
+    }
+    a %= adler_base;
+    b %= adler_base;
+    data += run;
+    size -= run;
+  }
+  return (b << 16) | a;
+}
+
+/* adler32 of two pieces back to back, from the checksum of each */
+static std::uint32_t adler32_combine(std::uint32_t first, std::uint32_t second,
+                                     std::size_t second_size) {
+  const std::uint64_t rem = second_size % adler_base;
+  std::uint64_t sum1 = first & 0xffff;
+  std::uint64_t sum2 = rem * sum1 % adler_base;
+  sum1 += (second & 0xffff) + adler_base - 1;
+  sum2 += (first >> 16) + (second >> 16) + adler_base - rem;
+  return std::uint32_t((sum2 % adler_base) << 16 | (sum1 % adler_base));
+}
+
+static void put_be32(std::vector<std::uint8_t> &out, std::uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(std::uint8_t(value >> shift));
+}
+
+/* chunk starts with room for its length and its type, the length and the
+ * crc of type and data are filled in here */
+static void finish_chunk(std::vector<std::uint8_t> &chunk) {
+  const std::uint32_t length = chunk.size() - 8;
+  for (int i = 0; i < 4; i++)
+    chunk[i] = std::uint8_t(length >> (24 - 8 * i));
+  put_be32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+}
+
+static std::vector<std::uint8_t> start_chunk(const char (&type)[5]) {
+  return {0, 0, 0, 0, std::uint8_t(type[0]), std::uint8_t(type[1]),
+          std::uint8_t(type[2]), std::uint8_t(type[3])};
+}
+
+/* deflate packs its bits starting at the least significant one */
+struct bit_writer {
+  std::vector<std::uint8_t> &out;
+  std::uint64_t bits = 0;
+  int count = 0;
+
+  void put(std::uint32_t value, int length) {
+    bits |= std::uint64_t(value) << count;
+    count += length;
+    while (count >= 8) {
+      out.push_back(std::uint8_t(bits));
+      bits >>= 8;
+      count -= 8;
+    }
+  }
+  void align() {
+    if (count > 0)
+      put(0, 8 - count);
+  }
+};
+
+/* Huffman codes are sent most significant bit first */
+static constexpr std::uint32_t reverse_bits(std::uint32_t code, int length) {
+  std::uint32_t reversed = 0;
+  for (int i = 0; i < length; i++)
+    reversed |= ((code >> i) & 1) << (length - 1 - i);
+  return reversed;
+}
+
+struct huffman_code {
+  std::uint16_t bits;
+  std::uint8_t length;
+};
+
+/* the fixed literal/length code of RFC 1951 3.2.6, already reversed */
+static constexpr std::array<huffman_code, 288> fixed_codes = [] {
+  std::array<huffman_code, 288> codes{};
+  for (int symbol = 0; symbol < 288; symbol++) {
+    std::uint32_t code;
+    int length;
+    if (symbol < 144)
+      code = 0x30 + symbol, length = 8;
+    else if (symbol < 256)
+      code = 0x190 + symbol - 144, length = 9;
+    else if (symbol < 280)
+      code = symbol - 256, length = 7;
+    else
+      code = 0xc0 + symbol - 280, length = 8;
+    codes[symbol] = {std::uint16_t(reverse_bits(code, length)),
+                     std::uint8_t(length)};
+  }
+  return codes;
+}();
+
+static constexpr std::array<std::uint16_t, 29> length_base = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static constexpr std::array<std::uint8_t, 29> length_extra = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr std::array<std::uint16_t, 30> distance_base = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static constexpr std::array<std::uint8_t, 30> distance_extra = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/* index of the last base that is not above value */
+template <std::size_t N>
+static int code_index(const std::array<std::uint16_t, N> &base, int value) {
+  return std::upper_bound(base.begin(), base.end(), value) - base.begin() - 1;
+}
+
+static void put_literal(bit_writer &bits, int symbol) {
+  bits.put(fixed_codes[symbol].bits, fixed_codes[symbol].length);
+}
+
+static void put_match(bit_writer &bits, int length, int distance) {
+  const int l = code_index(length_base, length);
+  put_literal(bits, 257 + l);
+  bits.put(length - length_base[l], length_extra[l]);
+  const int d = code_index(distance_base, distance);
+  bits.put(reverse_bits(d, 5), 5);
+  bits.put(distance - distance_base[d], distance_extra[d]);
+}
+
+/* length of the common prefix of a and b, up to limit bytes */
+static int match_length(const std::uint8_t *a, const std::uint8_t *b,
+                        int limit) {
+  int length = 0;
+  while (length + 8 <= limit) {
+    std::uint64_t x, y;
+    std::memcpy(&x, a + length, sizeof(x));
+    std::memcpy(&y, b + length, sizeof(y));
+    if (x != y)
+      return length + std::countr_zero(x ^ y) / 8;
+    length += 8;
+  }
+  while (length < limit && a[length] == b[length])
+    length++;
+  return length;
+}
+
+/* one fixed Huffman block of greedy matches, found by following up to
+ * chain_limit links of a hash chain per position */
+static void deflate_strip(const std::uint8_t *data, std::size_t size,
+                          int chain_limit, int insert_limit, bool final,
+                          std::vector<std::uint8_t> &out) {
+  bit_writer bits{out};
+  bits.put(final, 1);
+  bits.put(1, 2);
+
+  std::vector<std::int32_t> head(std::size_t(1) << hash_log, -1);
+  std::vector<std::int32_t> previous(size);
+  auto hash = [data](std::size_t i) {
+    const std::uint32_t v = data[i] | data[i + 1] << 8 | data[i + 2] << 16;
+    return (v * 2654435761u) >> (32 - hash_log);
+  };
+  auto insert = [&](std::size_t i) {
+    const std::uint32_t h = hash(i);
+    previous[i] = head[h];
+    head[h] = std::int32_t(i);
+  };
+
+  std::size_t i = 0;
+  while (i < size) {
+    int best_length = 0;
+    std::size_t best_distance = 0;
+    if (i + min_match <= size) {
+      const int limit = int(std::min<std::size_t>(max_match, size - i));
+      int chain = chain_limit;
+      for (std::int32_t candidate = head[hash(i)];
+           candidate >= 0 && i - candidate <= window_size && chain-- > 0;
+           candidate = previous[candidate]) {
+        const int length = match_length(data + candidate, data + i, limit);
+        if (length > best_length) {
+          best_length = length;
+          best_distance = i - candidate;
+          if (length == limit)
+            break;
+        }
+      }
+      insert(i);
+    }
+
+    if (best_length >= min_match) {
+      put_match(bits, best_length, best_distance);
+      for (std::size_t j = i + 1; best_length <= insert_limit &&
+                                  j < i + best_length && j + min_match <= size;
+           j++)
+        insert(j);
+      i += best_length;
+    } else {
+      put_literal(bits, data[i]);
+      i++;
+    }
+  }
+  put_literal(bits, 256);
+
+  if (final) {
+    bits.align();
+    return;
+  }
+  // empty stored block, the next strip starts on a byte
+  bits.put(0, 3);
+  bits.align();
+  out.insert(out.end(), {0x00, 0x00, 0xff, 0xff});
+}
+
+static void store_strip(const std::uint8_t *data, std::size_t size, bool final,
+                        std::vector<std::uint8_t> &out) {
+  do {
+    const std::uint16_t length = std::min<std::size_t>(size, 65535);
+    out.push_back(final && length == size);
+    out.insert(out.end(),
+               {std::uint8_t(length), std::uint8_t(length >> 8),
+                std::uint8_t(~length), std::uint8_t(~length >> 8)});
+    out.insert(out.end(), data, data + length);
+    data += length;
+    size -= length;
+  } while (size > 0);
+}
+
+static int paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+/* filters one row into out and returns the sum of the absolute values
+ * of the result as signed bytes. a and c, the pixels left of the
+ * current and of the one above, are 0 on the first pixel */
+template <typename Predict>
+static std::uint64_t filter_row(const std::uint8_t *row, const std::uint8_t *up,
+                                std::size_t size, std::size_t bpp,
+                                Predict predict, std::uint8_t *out) {
+  std::uint64_t score = 0;
+  for (std::size_t x = 0; x < bpp; x++) {
+    out[x] = std::uint8_t(row[x] - predict(0, up[x], 0));
+    score += std::abs(int(std::int8_t(out[x])));
+  }
+  for (std::size_t x = bpp; x < size; x++) {
+    out[x] = std::uint8_t(row[x] - predict(row[x - bpp], up[x], up[x - bpp]));
+    score += std::abs(int(std::int8_t(out[x])));
+  }
+  return score;
+}
+
+/* appends rows [first, last), each behind its filter type byte. with
+ * adaptive set every row gets the filter whose output has the smallest
+ * score, the usual heuristic, otherwise the rows are kept as they are */
+static void filter_rows(const std::uint8_t *pixels, std::size_t row_bytes,
+                        std::size_t bpp, std::uint32_t first, std::uint32_t last,
+                        bool adaptive, std::vector<std::uint8_t> &out) {
+  const std::vector<std::uint8_t> zero(row_bytes, 0);
+  std::vector<std::uint8_t> candidates(5 * row_bytes);
+  for (std::uint32_t y = first; y < last; y++) {
+    const std::uint8_t *row = pixels + y * row_bytes;
+    if (not adaptive) {
+      out.push_back(0);
+      out.insert(out.end(), row, row + row_bytes);
+      continue;
+    }
+
+    const std::uint8_t *up = y > 0 ? row - row_bytes : zero.data();
+    int best = 0;
+    std::uint64_t best_score = std::numeric_limits<std::uint64_t>::max();
+    auto try_filter = [&](int type, auto predict) {
+      const std::uint64_t score =
+          filter_row(row, up, row_bytes, bpp, predict,
+                     candidates.data() + type * row_bytes);
+      if (score < best_score) {
+        best = type;
+        best_score = score;
+      }
+    };
+    try_filter(0, [](int, int, int) { return 0; });
+    try_filter(1, [](int a, int, int) { return a; });
+    try_filter(2, [](int, int b, int) { return b; });
+    try_filter(3, [](int a, int b, int) { return (a + b) / 2; });
+    try_filter(4, [](int a, int b, int c) { return paeth(a, b, c); });
+
+    out.push_back(best);
+    const std::uint8_t *filtered = candidates.data() + best * row_bytes;
+    out.insert(out.end(), filtered, filtered + row_bytes);
+  }
+}
+
+bool write_png(const std::filesystem::path &path, const std::uint8_t *pixels,
+               std::uint32_t width, std::uint32_t height,
+               int components_per_pixel, int level, unsigned int jobs) {
+  static constexpr std::array<std::uint8_t, 4> color_types = {0, 4, 2, 6};
+  const std::size_t row_bytes = std::size_t(width) * components_per_pixel;
+  const std::uint32_t rows_per_strip =
+      std::max<std::size_t>(1, strip_bytes / (row_bytes + 1));
+  const std::size_t strip_count =
+      (std::size_t(height) + rows_per_strip - 1) / rows_per_strip;
+
+  struct strip {
+    std::vector<std::uint8_t> chunk;
+    std::uint32_t adler;
+    std::size_t size;
+  };
+  std::vector<strip> strips(strip_count);
+  parallel_for(strip_count, jobs, [&](std::size_t s) {
+    const std::uint32_t first = s * rows_per_strip;
+    const std::uint32_t last = std::min<std::size_t>(first + rows_per_strip,
+                                                     height);
+    std::vector<std::uint8_t> filtered;
+    filtered.reserve((last - first) * (row_bytes + 1));
+    filter_rows(pixels, row_bytes, components_per_pixel, first, last,
+                level > 0, filtered);
+    strips[s].adler = adler32(filtered.data(), filtered.size());
+    strips[s].size = filtered.size();
+
+    std::vector<std::uint8_t> &chunk = strips[s].chunk;
+    chunk = start_chunk("IDAT");
+    // zlib header: deflate with a 32K window, no dictionary
+    if (s == 0)
+      chunk.insert(chunk.end(), {0x78, 0x01});
+    const bool final = s + 1 == strip_count;
+    if (level == 0)
+      store_strip(filtered.data(), filtered.size(), final, chunk);
+    else
+      deflate_strip(filtered.data(), filtered.size(), max_chain[level],
+                    max_insert[level], final, chunk);
+    finish_chunk(chunk);
+  });
+
+  std::vector<std::uint8_t> header = start_chunk("IHDR");
+  put_be32(header, width);
+  put_be32(header, height);
+  header.insert(header.end(),
+                {8, color_types[components_per_pixel - 1], 0, 0, 0});
+  finish_chunk(header);
+
+  std::uint32_t adler = 1;
+  for (const strip &s : strips)
+    adler = adler32_combine(adler, s.adler, s.size);
+  std::vector<std::uint8_t> checksum = start_chunk("IDAT");
+  put_be32(checksum, adler);
+  finish_chunk(checksum);
+
+  std::vector<std::uint8_t> end = start_chunk("IEND");
+  finish_chunk(end);
+
+  static constexpr std::array<std::uint8_t, 8> signature = {
+      0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  std::ofstream file(path, std::ios::binary);
+  auto write = [&file](const auto &bytes) {
+    file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  };
+  write(signature);
+  write(header);
+  for (const strip &s : strips)
+    write(s.chunk);
+  write(checksum);
+  write(end);
+  file.close();
+  return not file.fail();
+}
@@ -0,0 +1,34 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_PNG_WRITER_H
+#define SILLY_PACKER_PNG_WRITER_H
+
+#include <cstdint>
+#include <filesystem>
+
+/* levels write_png() handles, 0 stores the pixels uncompressed and
+ * 1 to 3 search harder and harder for repeats */
+inline constexpr int max_strip_png_level = 3;
+
+/* writes an 8 bit per channel png of 1 to 4 components. the image is cut
+ * into horizontal strips that are filtered and deflated independently on
+ * up to jobs threads, each strip becomes its own IDAT chunk. false if the
+ * file could not be written */
+bool write_png(const std::filesystem::path &path, const std::uint8_t *pixels,
+               std::uint32_t width, std::uint32_t height,
+               int components_per_pixel, int level, unsigned int jobs);
+
+#endif
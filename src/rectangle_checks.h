@@ -17,6 +17,7 @@
 #define SILLY_SURVIVORS_RECTANGLE_CHECKS_H
 
 #include "packer.h"
+#include <algorithm>
 #include <cmath>
 
 static constexpr int invalid = -1;
@@ -47,6 +48,11 @@ inline bool canfit(const rectangle &small, const rectangle &big) {
   return (small.width <= big.width && small.height <= big.height);
 }
 
+/* the same rectangle turned by 90 degrees */
+inline rectangle rotate(const rectangle &r) {
+  return {r.x, r.y, r.height, r.width, not r.rotated};
+}
+
 /* Thanks to:
  * https://graphics.stanford.edu/%7Eseander/bithacks.html#RoundUpPowerOf2
  */
@@ -80,4 +86,31 @@ inline uint32_t calculate_min_side(const std::vector<image<int>> &images) {
   return minimum_side;
 }
 
+inline void sort_images(std::vector<image<int>> &images, sort_order order) {
+  auto by = [&images](auto key) {
+    std::sort(images.begin(), images.end(),
+              [&key](const image<int> &img1, const image<int> &img2) {
+                return key(img1) > key(img2);
+              });
+  };
+
+  switch (order) {
+  case sort_order::area:
+    by([](const image<int> &img) { return img.width * img.height; });
+    break;
+  case sort_order::perimeter:
+    by([](const image<int> &img) { return img.width + img.height; });
+    break;
+  case sort_order::max_side:
+    by([](const image<int> &img) { return std::max(img.width, img.height); });
+    break;
+  case sort_order::width:
+    by([](const image<int> &img) { return img.width; });
+    break;
+  case sort_order::height:
+    by([](const image<int> &img) { return img.height; });
+    break;
+  }
+}
+
 #endif
\ No newline at end of file
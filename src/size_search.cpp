@@ -0,0 +1,347 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Atlas size search shared by every packer. Instead of doubling one side
+ * and repacking until something fits, every allowed width is tried (in
+ * parallel) and for each of them the smallest height that fits is found
+ * with an exponential search followed by bisection. The smallest area wins.
+ * A pack attempt gives up at the first image that does not fit and widths
+ * that can no longer beat the best area found so far are abandoned early.
+ *
+ * With a maximum page size, images that do not fit on one page are spread
+ * over several. Each full page is filled greedily, largest images first and
+ * skipping the ones that no longer fit, then searched again on its own so
+ * that it is no bigger than its images need.
+ *
+ * Padding and alignment grow the images before all of this and the
+ * rectangles are moved back onto the images at the end. Block compressed
+ * atlases align to 4 so that no 4x4 block holds pixels of two sprites.
+ */
+#include "packer.h"
+#include "parallel.h"
+#include "rectangle_checks.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+using std::uint32_t;
+using std::uint64_t;
+
+/* when sides are multiples of a step there can be thousands of widths,
+ * only this many (evenly spread) are tried */
+static constexpr std::size_t max_width_candidates = 32;
+
+struct size_candidate {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  rectangle_vector rectangles;
+};
+
+/* smallest side allowed by the size policy that is >= n */
+static uint32_t allowed_side(uint32_t n, uint32_t step) {
+  n = std::max(n, 1u);
+  if (step == 0)
+    return closest_power_of_two(n);
+  return (n + step - 1) / step * step;
+}
+
+/* largest side allowed by the size policy that is <= n, 0 if there is none */
+static uint32_t allowed_side_below(uint32_t n, uint32_t step) {
+  if (n == 0)
+    return 0;
+  if (step == 0)
+    return std::bit_floor(n);
+  return n / step * step;
+}
+
+static std::vector<uint32_t> allowed_sides(uint32_t from, uint32_t to,
+                                           uint32_t step) {
+  std::vector<uint32_t> sides;
+  for (uint32_t side = allowed_side(from, step); side <= to;
+       side = allowed_side(side + 1, step))
+    sides.push_back(side);
+  return sides;
+}
+
+/* smaller area first, then the more square atlas, then the narrower one */
+static bool is_better_size(const size_candidate &c1,
+                           const size_candidate &c2) {
+  const uint64_t area1 = uint64_t(c1.width) * c1.height;
+  const uint64_t area2 = uint64_t(c2.width) * c2.height;
+  if (area1 != area2)
+    return area1 < area2;
+  if (std::max(c1.width, c1.height) != std::max(c2.width, c2.height))
+    return std::max(c1.width, c1.height) < std::max(c2.width, c2.height);
+  return c1.width < c2.width;
+}
+
+static void publish_area(std::atomic<uint64_t> &best_area, uint64_t area) {
+  uint64_t current = best_area.load();
+  while (area < current && !best_area.compare_exchange_weak(current, area))
+    ;
+}
+
+/* smallest height that fits the images at this width, or an empty
+ * candidate if none does up to max_height or none can beat the
+ * best area that has already been found */
+static size_candidate fit_height(const std::vector<image<int>> &images,
+                                 const pack_function &pack, uint32_t width,
+                                 uint32_t min_height, uint32_t max_height,
+                                 uint32_t step,
+                                 std::atomic<uint64_t> &best_area) {
+  size_candidate fit;
+  auto attempt = [&](uint32_t height) {
+    rectangle_vector placed = pack(width, height, images, false);
+    if (is_invalid_rectangle(placed.front()))
+      return false;
+    fit = {width, height, std::move(placed)};
+    return true;
+  };
+  /* the heights tried never depend on best_area, it is only used to give
+   * up once even the smallest untried height would lose. that keeps the
+   * result independent of how the threads are scheduled */
+  auto cannot_win = [&](uint32_t failed) {
+    const uint32_t smallest =
+        allowed_side(std::max(failed + 1, min_height), step);
+    return uint64_t(width) * smallest > best_area;
+  };
+
+  // grow until something fits, max_height itself is always tried
+  uint32_t failed = 0;
+  uint32_t height = allowed_side(min_height, step);
+  while (true) {
+    if (height > max_height || cannot_win(failed))
+      return {};
+    if (attempt(height))
+      break;
+    if (height == max_height)
+      return {};
+    failed = height;
+    height = std::min(allowed_side(height * 2, step), max_height);
+  }
+
+  // then bisect between the last failure and the first fit
+  std::vector<uint32_t> between =
+      allowed_sides(std::max(failed + 1, min_height), fit.height - 1, step);
+  std::size_t low = 0, high = between.size();
+  while (low < high) {
+    std::size_t mid = low + (high - low) / 2;
+    if (attempt(between[mid]))
+      high = mid;
+    else
+      low = mid + 1;
+  }
+
+  publish_area(best_area, uint64_t(fit.width) * fit.height);
+  return fit;
+}
+
+/* smallest single page that holds every image, no larger than
+ * max_width x max_height (both already allowed sides) */
+static size_candidate search_page_size(const std::vector<image<int>> &images,
+                                       const pack_function &pack,
+                                       const packer_options &options,
+                                       uint32_t max_width, uint32_t max_height) {
+  uint64_t total_area = 0;
+  uint32_t widest = 0, tallest = 0;
+  for (const image<int> &img : images) {
+    total_area += uint64_t(img.width) * img.height;
+    // an image that may be turned only forces its short side on either axis
+    const int short_side = std::min(img.width, img.height);
+    widest = std::max<uint32_t>(widest,
+                                options.allow_rotate ? short_side : img.width);
+    tallest = std::max<uint32_t>(
+        tallest, options.allow_rotate ? short_side : img.height);
+  }
+
+  /* widths stay within a factor of two of the side of a square holding
+   * the total area, anything further away makes for strip-like atlases
+   * that GPUs and image viewers handle badly */
+  const uint32_t square_side = std::ceil(std::sqrt(double(total_area)));
+  std::vector<uint32_t> widths = allowed_sides(
+      std::max(widest, square_side / 2),
+      std::min(max_width,
+               allowed_side(std::max(widest, 2 * square_side),
+                            options.size_step)),
+      options.size_step);
+  if (widths.size() > max_width_candidates) {
+    std::vector<uint32_t> spread;
+    for (std::size_t i = 0; i < max_width_candidates; i++)
+      spread.push_back(
+          widths[i * (widths.size() - 1) / (max_width_candidates - 1)]);
+    widths.swap(spread);
+  }
+
+  std::atomic<uint64_t> best_area{std::numeric_limits<uint64_t>::max()};
+  std::vector<size_candidate> candidates(widths.size());
+  parallel_for(widths.size(), options.jobs, [&](std::size_t i) {
+    const uint32_t min_height = std::min<uint64_t>(
+        std::max<uint64_t>(tallest, (total_area + widths[i] - 1) / widths[i]),
+        uint64_t(max_height) + 1);
+    candidates[i] = fit_height(images, pack, widths[i], min_height, max_height,
+                               options.size_step, best_area);
+  });
+
+  /* picked after every candidate has finished so that the result does
+   * not depend on which thread got there first */
+  size_candidate *best = nullptr;
+  for (size_candidate &candidate : candidates) {
+    if (candidate.rectangles.empty())
+      continue;
+    if (best == nullptr || is_better_size(candidate, *best))
+      best = &candidate;
+  }
+
+  if (best == nullptr)
+    return {};
+  return std::move(*best);
+}
+
+/* fills one max_width x max_height page with whatever fits and then
+ * shrinks it. returns the indices into images of the packed images */
+static std::vector<int> fill_page(const std::vector<image<int>> &images,
+                                  const pack_function &pack,
+                                  const packer_options &options,
+                                  uint32_t max_width, uint32_t max_height,
+                                  size_candidate &page) {
+  rectangle_vector placed = pack(max_width, max_height, images, true);
+  std::vector<int> packed;
+  std::vector<image<int>> packed_images;
+  page = {max_width, max_height, {}};
+  for (int i = 0; i < images.size(); i++) {
+    if (is_invalid_rectangle(placed[i]))
+      continue;
+    packed.push_back(i);
+    packed_images.push_back(images[i]);
+    page.rectangles.push_back(placed[i]);
+  }
+  if (packed.empty())
+    return packed;
+
+  /* the greedy fill only used what it needed of the page, a fresh
+   * search over just those images usually finds a smaller one */
+  size_candidate smaller = search_page_size(packed_images, pack, options,
+                                            max_width, max_height);
+  if (not smaller.rectangles.empty())
+    page = std::move(smaller);
+  return packed;
+}
+
+/* images grown by padding on every side and then rounded up to a
+ * multiple of alignment. the packers only ever place images against the
+ * atlas origin or against each other, so every position comes out
+ * aligned too */
+static std::vector<image<int>>
+padded_images(const std::vector<image<int>> &images, int padding,
+              int alignment) {
+  std::vector<image<int>> padded(images);
+  for (image<int> &img : padded) {
+    img.width =
+        (img.width + 2 * padding + alignment - 1) / alignment * alignment;
+    img.height =
+        (img.height + 2 * padding + alignment - 1) / alignment * alignment;
+  }
+  return padded;
+}
+
+static atlas_properties search_pages(const std::vector<image<int>> &images,
+                                     const pack_function &pack,
+                                     const packer_options &options) {
+  const uint32_t max_width = allowed_side_below(
+      std::min(max_atlas_side, options.max_width ? options.max_width
+                                                 : max_atlas_side),
+      options.size_step);
+  const uint32_t max_height = allowed_side_below(
+      std::min(max_atlas_side, options.max_height ? options.max_height
+                                                  : max_atlas_side),
+      options.size_step);
+  if (max_width == 0 || max_height == 0)
+    return {};
+
+  atlas_properties atlas{.pages = {},
+                         .rectangles = rectangle_vector(images.size()),
+                         .filename = {}};
+  /* positions in images of what is still waiting for a page, kept in
+   * the packer's order so every page is filled largest first */
+  std::vector<int> remaining(images.size());
+  for (int i = 0; i < images.size(); i++)
+    remaining[i] = i;
+
+  const bool paged = options.max_width != 0 || options.max_height != 0;
+  while (not remaining.empty()) {
+    std::vector<image<int>> page_images;
+    for (int index : remaining)
+      page_images.push_back(images[index]);
+
+    size_candidate page =
+        search_page_size(page_images, pack, options, max_width, max_height);
+    std::vector<int> packed;
+    if (not page.rectangles.empty()) {
+      packed.swap(remaining);
+    } else {
+      if (not paged)
+        return {};
+      std::vector<int> packed_local = fill_page(page_images, pack, options,
+                                                max_width, max_height, page);
+      // an image larger than a whole page
+      if (packed_local.empty())
+        return {};
+
+      std::vector<int> left;
+      std::size_t next = 0;
+      for (int i = 0; i < remaining.size(); i++) {
+        if (next < packed_local.size() && packed_local[next] == i) {
+          packed.push_back(remaining[i]);
+          next++;
+        } else {
+          left.push_back(remaining[i]);
+        }
+      }
+      remaining.swap(left);
+    }
+
+    const int page_index = atlas.pages.size();
+    atlas.pages.push_back({page.width, page.height});
+    for (int i = 0; i < packed.size(); i++) {
+      atlas.rectangles[packed[i]] = page.rectangles[i];
+      atlas.rectangles[packed[i]].page = page_index;
+    }
+  }
+  return atlas;
+}
+
+atlas_properties search_atlas_size(const std::vector<image<int>> &images,
+                                   const pack_function &pack,
+                                   const packer_options &options) {
+  if (options.alignment <= 1 && options.padding == 0)
+    return search_pages(images, pack, options);
+
+  atlas_properties atlas = search_pages(
+      padded_images(images, options.padding, std::max(options.alignment, 1u)),
+      pack, options);
+  // the rectangles are those of the images, inside their padding
+  for (int i = 0; i < atlas.rectangles.size() && not atlas.pages.empty();
+       i++) {
+    rectangle &rect = atlas.rectangles[i];
+    rect.x += options.padding;
+    rect.y += options.padding;
+    rect.width = rect.rotated ? images[i].height : images[i].width;
+    rect.height = rect.rotated ? images[i].width : images[i].height;
+  }
+  return atlas;
+}
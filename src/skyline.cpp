@@ -0,0 +1,154 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * This file is an implementation of the Skyline Bottom-Left strategy for
+ * Rectangle Packing. Instead of a list of free rectangles only the top
+ * outline ("skyline") of everything placed so far is kept, as a list of
+ * horizontal segments. Uniformly sized tiles keep that list short, which
+ * makes packing tens of thousands of them close to linear. Based on:
+ * (White-paper that discusses various strategies)
+ * https://raw.githubusercontent.com/rougier/freetype-gl/master/doc/RectangleBinPack.pdf
+ * (existing implementation)
+ * https://github.com/juj/RectangleBinPack/blob/master/SkylineBinPack.cpp
+ */
+#include "packer.h"
+#include "rectangle_checks.h"
+#include <algorithm>
+#include <vector>
+
+struct skyline_segment {
+  int x, y, width;
+};
+
+using skyline_segments = std::vector<skyline_segment>;
+
+/* y at which a width x height rectangle can sit when its left edge is
+ * at the start of segment index, or invalid if it sticks out */
+static int fit_at_segment(const skyline_segments &line, int index,
+                          int width, int height, int atlas_width,
+                          int atlas_height) {
+  const int x = line[index].x;
+  if (x + width > atlas_width)
+    return invalid;
+
+  int y = line[index].y;
+  int width_left = width;
+  for (int i = index; width_left > 0; i++) {
+    y = std::max(y, line[i].y);
+    if (y + height > atlas_height)
+      return invalid;
+    width_left -= line[i].width;
+  }
+  return y;
+}
+
+/* raises the skyline over the placed rectangle, trims or removes the
+ * segments it now covers and merges neighbours of equal height */
+static void add_level(skyline_segments &line, int index,
+                      const rectangle &placed) {
+  line.insert(line.begin() + index,
+              {placed.x, placed.y + placed.height, placed.width});
+
+  const int right = placed.x + placed.width;
+  int i = index + 1;
+  while (i < line.size() && line[i].x < right) {
+    const int shrink = right - line[i].x;
+    if (line[i].width <= shrink) {
+      line.erase(line.begin() + i);
+      continue;
+    }
+    line[i].x += shrink;
+    line[i].width -= shrink;
+    break;
+  }
+
+  for (int j = 0; j + 1 < line.size();) {
+    if (line[j].y == line[j + 1].y) {
+      line[j].width += line[j + 1].width;
+      line.erase(line.begin() + j + 1);
+      continue;
+    }
+    j++;
+  }
+}
+
+static rectangle_vector
+skyline_pack_rectangles(int atlas_width, int atlas_height,
+                        const std::vector<image<int>> &rectangles,
+                        bool allow_rotate, bool partial) {
+  skyline_segments line = {{0, 0, atlas_width}};
+  rectangle_vector placed;
+
+  for (const image<int> &to_fit : rectangles) {
+    const rectangle wanted[2] = {
+        {0, 0, to_fit.width, to_fit.height},
+        {0, 0, to_fit.height, to_fit.width, true},
+    };
+    const int orientations =
+        (allow_rotate && to_fit.width != to_fit.height) ? 2 : 1;
+
+    /* lowest top edge wins, on a tie the narrower segment so that
+     * wide segments stay available for wide images */
+    int best_index = invalid, best_top = 0, best_width = 0, best_y = 0;
+    int best_turn = 0;
+    for (int i = 0; i < line.size(); i++) {
+      for (int turn = 0; turn < orientations; turn++) {
+        int y = fit_at_segment(line, i, wanted[turn].width,
+                               wanted[turn].height, atlas_width, atlas_height);
+        if (y == invalid)
+          continue;
+
+        const int top = y + wanted[turn].height;
+        if (best_index == invalid || top < best_top ||
+            (top == best_top && line[i].width < best_width)) {
+          best_index = i;
+          best_top = top;
+          best_width = line[i].width;
+          best_y = y;
+          best_turn = turn;
+        }
+      }
+    }
+
+    if (best_index == invalid) {
+      if (not partial)
+        return rectangle_vector{make_invalid_rectangle()};
+      placed.push_back(make_invalid_rectangle());
+      continue;
+    }
+
+    rectangle rect = {line[best_index].x, best_y, wanted[best_turn].width,
+                      wanted[best_turn].height, wanted[best_turn].rotated};
+    placed.push_back(rect);
+    add_level(line, best_index, rect);
+  } // for to_fit input rectangles
+
+  return placed;
+}
+
+atlas_properties skyline(std::vector<image<int>> &images,
+                         const packer_options &options) {
+  // tallest first keeps the skyline flat
+  sort_images(images, options.sort.value_or(sort_order::height));
+
+  return search_atlas_size(
+      images,
+      [&options](int width, int height,
+                 const std::vector<image<int>> &rectangles, bool partial) {
+        return skyline_pack_rectangles(width, height, rectangles,
+                                       options.allow_rotate, partial);
+      },
+      options);
+}
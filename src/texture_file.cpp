@@ -0,0 +1,320 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/*
+ * Texture files for atlas pages. KTX2 and DDS store the page bytes as they
+ * are, so a loader can map the file and hand the levels to the GPU. KTX2
+ * keeps the smallest level first and pads every level to its block size,
+ * with the data format descriptor the spec requires. DDS keeps the largest
+ * level first and uses the DX10 extension header for BC7 only. QOI is
+ * encoded here, it is a single pass over the pixels. Specs:
+ * https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+ * https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+ * https://qoiformat.org/qoi-specification.pdf
+ */
+#include "texture_file.h"
+#include <algorithm>
+#include <fstream>
+
+/* every field of ktx2 and dds is little endian */
+template <typename T>
+static void put_le(std::vector<std::uint8_t> &out, T value) {
+  for (std::size_t i = 0; i < sizeof(T); i++)
+    out.push_back(std::uint8_t(std::uint64_t(value) >> (8 * i)));
+}
+
+static void put_be32(std::vector<std::uint8_t> &out, std::uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(std::uint8_t(value >> shift));
+}
+
+static std::vector<std::size_t>
+level_sizes(const std::vector<std::uint8_t> &data,
+            const std::vector<std::size_t> &mip_offsets) {
+  std::vector<std::size_t> sizes;
+  for (std::size_t i = 0; i < mip_offsets.size(); i++)
+    sizes.push_back((i + 1 < mip_offsets.size() ? mip_offsets[i + 1]
+                                                : data.size()) -
+                    mip_offsets[i]);
+  return sizes;
+}
+
+static std::vector<std::uint8_t> dds_header(block_format format,
+                                            std::uint32_t width,
+                                            std::uint32_t height,
+                                            std::uint32_t levels,
+                                            std::size_t first_level_size) {
+  constexpr std::uint32_t caps = 0x1, height_flag = 0x2, width_flag = 0x4,
+                          pitch = 0x8, pixel_format = 0x1000,
+                          mipmap_count = 0x20000, linear_size = 0x80000;
+  const bool compressed = format != block_format::rgba8;
+
+  std::vector<std::uint8_t> out = {'D', 'D', 'S', ' '};
+  put_le<std::uint32_t>(out, 124);
+  put_le<std::uint32_t>(out, caps | height_flag | width_flag | pixel_format |
+                                 (compressed ? linear_size : pitch) |
+                                 (levels > 1 ? mipmap_count : 0));
+  put_le(out, height);
+  put_le(out, width);
+  put_le<std::uint32_t>(out, compressed ? first_level_size : width * 4);
+  put_le<std::uint32_t>(out, 0);
+  put_le(out, levels);
+  for (int i = 0; i < 11; i++)
+    put_le<std::uint32_t>(out, 0);
+
+  // pixel format, bc1 and bc3 have their own four character code
+  put_le<std::uint32_t>(out, 32);
+  if (compressed) {
+    const char *four_cc = format == block_format::bc1   ? "DXT1"
+                          : format == block_format::bc3 ? "DXT5"
+                                                        : "DX10";
+    put_le<std::uint32_t>(out, 0x4);
+    out.insert(out.end(), four_cc, four_cc + 4);
+    for (int i = 0; i < 5; i++)
+      put_le<std::uint32_t>(out, 0);
+  } else {
+    put_le<std::uint32_t>(out, 0x41);
+    put_le<std::uint32_t>(out, 0);
+    put_le<std::uint32_t>(out, 32);
+    for (std::uint32_t mask : {0xffu, 0xff00u, 0xff0000u, 0xff000000u})
+      put_le(out, mask);
+  }
+
+  put_le<std::uint32_t>(out, 0x1000 | (levels > 1 ? 0x400008 : 0));
+  for (int i = 0; i < 4; i++)
+    put_le<std::uint32_t>(out, 0);
+
+  if (format == block_format::bc7) {
+    put_le<std::uint32_t>(out, 98); // DXGI_FORMAT_BC7_UNORM
+    put_le<std::uint32_t>(out, 3);  // 2D texture
+    put_le<std::uint32_t>(out, 0);
+    put_le<std::uint32_t>(out, 1);
+    put_le<std::uint32_t>(out, 0);
+  }
+  return out;
+}
+
+/* the basic data format descriptor: one sample per channel for rgba8,
+ * the samples the Khronos data format spec gives each block format */
+static std::vector<std::uint8_t> ktx2_descriptor(block_format format) {
+  struct sample {
+    std::uint32_t bit_offset, bit_length, channel, upper;
+  };
+  constexpr std::uint32_t block_upper = 0xffffffff;
+  std::uint32_t model = 0, block_dimensions = 0, bytes = 0;
+  std::vector<sample> samples;
+  switch (format) {
+  case block_format::rgba8:
+    model = 1, block_dimensions = 0, bytes = 4;
+    samples = {{0, 8, 0, 255}, {8, 8, 1, 255}, {16, 8, 2, 255},
+               {24, 8, 15, 255}};
+    break;
+  case block_format::bc1:
+    model = 128, block_dimensions = 0x0303, bytes = 8;
+    samples = {{0, 64, 1, block_upper}};
+    break;
+  case block_format::bc3:
+    model = 130, block_dimensions = 0x0303, bytes = 16;
+    samples = {{0, 64, 15, block_upper}, {64, 64, 0, block_upper}};
+    break;
+  case block_format::bc7:
+    model = 134, block_dimensions = 0x0303, bytes = 16;
+    samples = {{0, 128, 0, block_upper}};
+    break;
+  }
+
+  const std::uint32_t block_size = 24 + 16 * samples.size();
+  std::vector<std::uint8_t> out;
+  put_le<std::uint32_t>(out, 4 + block_size);
+  put_le<std::uint32_t>(out, 0);
+  put_le<std::uint32_t>(out, 2 | block_size << 16);
+  // BT.709 primaries, linear transfer, straight alpha
+  put_le<std::uint32_t>(out, model | 1 << 8 | 1 << 16);
+  put_le(out, block_dimensions);
+  put_le(out, bytes);
+  put_le<std::uint32_t>(out, 0);
+  for (const sample &s : samples) {
+    put_le<std::uint32_t>(out, s.bit_offset | (s.bit_length - 1) << 16 |
+                                   s.channel << 24);
+    put_le<std::uint32_t>(out, 0);
+    put_le<std::uint32_t>(out, 0);
+    put_le(out, s.upper);
+  }
+  return out;
+}
+
+static std::uint32_t ktx2_vk_format(block_format format) {
+  switch (format) {
+  case block_format::rgba8:
+    return 37; // VK_FORMAT_R8G8B8A8_UNORM
+  case block_format::bc1:
+    return 133; // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+  case block_format::bc3:
+    return 137; // VK_FORMAT_BC3_UNORM_BLOCK
+  case block_format::bc7:
+    return 145; // VK_FORMAT_BC7_UNORM_BLOCK
+  }
+  return 0;
+}
+
+static bool write_ktx2(std::ofstream &file, block_format format,
+                       std::uint32_t width, std::uint32_t height,
+                       const std::vector<std::uint8_t> &data,
+                       const std::vector<std::size_t> &mip_offsets) {
+  static constexpr std::uint8_t identifier[] = {
+      0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+  static constexpr char writer[] = "KTXwriter\0silly_packer";
+  const std::vector<std::size_t> sizes = level_sizes(data, mip_offsets);
+  const std::uint32_t levels = sizes.size();
+
+  const std::vector<std::uint8_t> descriptor = ktx2_descriptor(format);
+  std::vector<std::uint8_t> key_values;
+  put_le<std::uint32_t>(key_values, sizeof(writer));
+  key_values.insert(key_values.end(), writer, writer + sizeof(writer));
+  key_values.resize((key_values.size() + 3) / 4 * 4);
+
+  /* levels go smallest first, each on a multiple of its block size */
+  const std::size_t alignment = std::max<std::size_t>(4, block_bytes(format));
+  const std::size_t descriptor_offset = 80 + 24 * levels;
+  const std::size_t key_value_offset = descriptor_offset + descriptor.size();
+  std::vector<std::size_t> level_offsets(levels);
+  std::size_t end = key_value_offset + key_values.size();
+  for (std::uint32_t level = levels; level-- > 0;) {
+    end = (end + alignment - 1) / alignment * alignment;
+    level_offsets[level] = end;
+    end += sizes[level];
+  }
+
+  std::vector<std::uint8_t> header(identifier, identifier + 12);
+  for (std::uint32_t field :
+       {ktx2_vk_format(format), 1u, width, height, 0u, 0u, 1u, levels, 0u})
+    put_le(header, field);
+  put_le<std::uint32_t>(header, descriptor_offset);
+  put_le<std::uint32_t>(header, descriptor.size());
+  put_le<std::uint32_t>(header, key_value_offset);
+  put_le<std::uint32_t>(header, key_values.size());
+  put_le<std::uint64_t>(header, 0);
+  put_le<std::uint64_t>(header, 0);
+  for (std::uint32_t level = 0; level < levels; level++) {
+    put_le<std::uint64_t>(header, level_offsets[level]);
+    put_le<std::uint64_t>(header, sizes[level]);
+    put_le<std::uint64_t>(header, sizes[level]);
+  }
+  header.insert(header.end(), descriptor.begin(), descriptor.end());
+  header.insert(header.end(), key_values.begin(), key_values.end());
+
+  file.write(reinterpret_cast<const char *>(header.data()), header.size());
+  std::size_t written = header.size();
+  for (std::uint32_t level = levels; level-- > 0;) {
+    for (; written < level_offsets[level]; written++)
+      file.put(0);
+    file.write(reinterpret_cast<const char *>(data.data()) +
+                   mip_offsets[level],
+               sizes[level]);
+    written += sizes[level];
+  }
+  return true;
+}
+
+/* one pass over the pixels: runs of the previous pixel, a hash table of
+ * 64 recently seen ones, small differences to the previous pixel and
+ * full pixels, in that order of preference */
+static std::vector<std::uint8_t> qoi_encode(const std::uint8_t *pixels,
+                                            std::uint32_t width,
+                                            std::uint32_t height) {
+  struct rgba {
+    std::uint8_t r, g, b, a;
+    bool operator==(const rgba &) const = default;
+  };
+  std::vector<std::uint8_t> out = {'q', 'o', 'i', 'f'};
+  put_be32(out, width);
+  put_be32(out, height);
+  out.insert(out.end(), {4, 0});
+
+  std::array<rgba, 64> seen{};
+  rgba previous = {0, 0, 0, 255};
+  int run = 0;
+  const std::size_t count = std::size_t(width) * height;
+  for (std::size_t i = 0; i < count; i++) {
+    const std::uint8_t *p = pixels + i * 4;
+    const rgba pixel = {p[0], p[1], p[2], p[3]};
+    if (pixel == previous) {
+      run++;
+      if (run == 62 || i + 1 == count) {
+        out.push_back(0xc0 | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+    if (run > 0) {
+      out.push_back(0xc0 | (run - 1));
+      run = 0;
+    }
+
+    const int index = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) %
+                      64;
+    if (seen[index] == pixel) {
+      out.push_back(index);
+    } else {
+      seen[index] = pixel;
+      if (pixel.a != previous.a) {
+        out.insert(out.end(), {0xff, pixel.r, pixel.g, pixel.b, pixel.a});
+      } else {
+        const int dr = std::int8_t(pixel.r - previous.r);
+        const int dg = std::int8_t(pixel.g - previous.g);
+        const int db = std::int8_t(pixel.b - previous.b);
+        const int dr_dg = dr - dg, db_dg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1)
+          out.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+        else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                 db_dg >= -8 && db_dg <= 7)
+          out.insert(out.end(), {std::uint8_t(0x80 | (dg + 32)),
+                                 std::uint8_t((dr_dg + 8) << 4 | (db_dg + 8))});
+        else
+          out.insert(out.end(), {0xfe, pixel.r, pixel.g, pixel.b});
+      }
+    }
+    previous = pixel;
+  }
+  out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+  return out;
+}
+
+bool write_texture_file(const std::filesystem::path &path,
+                        texture_container container, block_format format,
+                        std::uint32_t width, std::uint32_t height,
+                        const std::vector<std::uint8_t> &data,
+                        const std::vector<std::size_t> &mip_offsets) {
+  std::ofstream file(path, std::ios::binary);
+  auto write = [&file](const std::vector<std::uint8_t> &bytes) {
+    file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  };
+  switch (container) {
+  case texture_container::ktx2:
+    write_ktx2(file, format, width, height, data, mip_offsets);
+    break;
+  case texture_container::dds:
+    write(dds_header(format, width, height, mip_offsets.size(),
+                     level_sizes(data, mip_offsets).front()));
+    write(data);
+    break;
+  case texture_container::qoi:
+    write(qoi_encode(data.data(), width, height));
+    break;
+  }
+  file.close();
+  return not file.fail();
+}
@@ -0,0 +1,54 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_TEXTURE_FILE_H
+#define SILLY_PACKER_TEXTURE_FILE_H
+
+#include "block_encoder.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* files an atlas page can be written to. ktx2 and dds keep the texture
+ * format and every mip level as they are, ready to be uploaded. qoi is
+ * a fast lossless image format that only holds rgba8 pixels */
+enum class texture_container {
+  ktx2,
+  dds,
+  qoi,
+};
+
+inline constexpr std::array<std::pair<std::string_view, texture_container>, 3>
+    texture_container_names{{
+        {"ktx2", texture_container::ktx2},
+        {"dds", texture_container::dds},
+        {"qoi", texture_container::qoi},
+    }};
+
+/* writes one page, data holds its mip levels back to back starting at
+ * mip_offsets, qoi only writes the first one. false if the file could
+ * not be written */
+bool write_texture_file(const std::filesystem::path &path,
+                        texture_container container, block_format format,
+                        std::uint32_t width, std::uint32_t height,
+                        const std::vector<std::uint8_t> &data,
+                        const std::vector<std::size_t> &mip_offsets);
+
+#endif
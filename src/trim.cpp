@@ -0,0 +1,110 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "trim.h"
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SILLY_PACKER_SSE2
+#endif
+
+static constexpr int rgba = 4;
+
+static bool is_opaque(const unsigned char *row, int x) {
+  return row[x * rgba + 3] != 0;
+}
+
+/* first pixel in [begin, end) with non-zero alpha, end if there is none */
+static int first_opaque(const unsigned char *row, int begin, int end) {
+  int x = begin;
+#ifdef SILLY_PACKER_SSE2
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+  const __m128i zero = _mm_setzero_si128();
+  for (; x + 4 <= end; x += 4) {
+    __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x * rgba));
+    // four bits per pixel, set when its alpha is zero
+    unsigned int transparent = _mm_movemask_epi8(
+        _mm_cmpeq_epi32(_mm_and_si128(pixels, alpha), zero));
+    if (transparent != 0xffff)
+      return x + std::countr_one(transparent) / rgba;
+  }
+#endif
+  for (; x < end; x++) {
+    if (is_opaque(row, x))
+      return x;
+  }
+  return end;
+}
+
+/* last pixel in [begin, end) with non-zero alpha, begin - 1 if none */
+static int last_opaque(const unsigned char *row, int begin, int end) {
+  int x = end;
+#ifdef SILLY_PACKER_SSE2
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+  const __m128i zero = _mm_setzero_si128();
+  for (; x - 4 >= begin; x -= 4) {
+    __m128i pixels = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(row + (x - 4) * rgba));
+    std::uint16_t transparent = _mm_movemask_epi8(
+        _mm_cmpeq_epi32(_mm_and_si128(pixels, alpha), zero));
+    if (transparent != 0xffff)
+      return x - 1 - std::countl_one(transparent) / rgba;
+  }
+#endif
+  for (; x > begin; x--) {
+    if (is_opaque(row, x - 1))
+      return x - 1;
+  }
+  return begin - 1;
+}
+
+rectangle opaque_bounds(const unsigned char *rgba_pixels, int width,
+                        int height) {
+  const std::size_t stride = std::size_t(width) * rgba;
+  auto row = [&](int y) { return rgba_pixels + y * stride; };
+
+  int top = 0;
+  while (top < height && first_opaque(row(top), 0, width) == width)
+    top++;
+  if (top == height)
+    return {0, 0, 1, 1};
+
+  int bottom = height - 1;
+  while (first_opaque(row(bottom), 0, width) == width)
+    bottom--;
+
+  /* every row only has to look outside the columns that are already
+   * known to be inside the bounds */
+  int left = width, right = -1;
+  for (int y = top; y <= bottom; y++) {
+    left = std::min(left, first_opaque(row(y), 0, left));
+    right = std::max(right, last_opaque(row(y), right + 1, width));
+  }
+
+  return {left, top, right - left + 1, bottom - top + 1};
+}
+
+void trim_image(image<int> &img) {
+  rectangle bounds = opaque_bounds(img.data, img.source_width,
+                                   img.source_height);
+  img.offset_x = bounds.x;
+  img.offset_y = bounds.y;
+  img.width = bounds.width;
+  img.height = bounds.height;
+}
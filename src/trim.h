@@ -0,0 +1,29 @@
+/* Copyright (C) Amritpal Singh 2025
+
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SILLY_PACKER_TRIM_H
+#define SILLY_PACKER_TRIM_H
+
+#include "packer.h"
+
+/* tight bounds of the pixels with non-zero alpha in an RGBA image,
+ * an image without any of them is reduced to its top left pixel */
+rectangle opaque_bounds(const unsigned char *rgba, int width, int height);
+
+/* shrinks img to its opaque bounds, the pixels stay where they are and
+ * offset_x, offset_y record where the packed region starts in them */
+void trim_image(image<int> &img);
+
+#endif